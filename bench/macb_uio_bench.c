@@ -0,0 +1,494 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* Copyright(c) 2022 - 2025 Phytium Technology Co., Ltd. */
+
+/*
+ * macb_uio_bench - measure what macb_uio delivers to userspace.
+ *
+ * Opens /dev/uioN, maps its regions and reports latency percentiles
+ * for MMIO accesses, irqcontrol writes, interrupt wakeups and link
+ * event wakeups. Run it while no PMD uses the port.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "macb_uio.h"
+
+#define BENCH_MAX_MAPS		8
+#define BENCH_MAX_REGS		8
+
+#define GEM_IDR			0x002c
+#define GEM_MID			0x00fc
+
+struct bench_map {
+	char name[32];
+	size_t size;
+	size_t offset;
+	void *base;
+};
+
+struct bench_reg {
+	char map[32];
+	size_t offset;
+};
+
+static const char *uio_name = "uio0";
+static const char *irq_uio_name;
+static unsigned int iterations = 10000;
+static unsigned int timeout_ms = 10000;
+static unsigned int queue;
+static int do_write;
+static unsigned int nr_regs;
+static struct bench_reg regs[BENCH_MAX_REGS];
+
+static struct bench_map maps[BENCH_MAX_MAPS];
+static unsigned int nr_maps;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const uint64_t *v, unsigned int n, double p)
+{
+	unsigned int i = (unsigned int)(p * (n - 1) + 0.5);
+
+	return v[i < n ? i : n - 1];
+}
+
+static void report(const char *test, uint64_t *v, unsigned int n)
+{
+	if (!n) {
+		printf("%-28s %8u %s\n", test, 0, "no samples");
+		return;
+	}
+
+	qsort(v, n, sizeof(*v), cmp_u64);
+	printf("%-28s %8u %8llu %8llu %8llu %8llu %8llu %8llu\n", test, n,
+	       (unsigned long long)v[0],
+	       (unsigned long long)percentile(v, n, 0.50),
+	       (unsigned long long)percentile(v, n, 0.90),
+	       (unsigned long long)percentile(v, n, 0.99),
+	       (unsigned long long)percentile(v, n, 0.999),
+	       (unsigned long long)v[n - 1]);
+}
+
+static int read_sysfs(const char *path, char *buf, size_t len)
+{
+	ssize_t r;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	r = read(fd, buf, len - 1);
+	close(fd);
+	if (r < 0)
+		return -errno;
+
+	buf[r] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+static int read_sysfs_ul(const char *path, unsigned long *val)
+{
+	char buf[64];
+	int err;
+
+	err = read_sysfs(path, buf, sizeof(buf));
+	if (err)
+		return err;
+
+	*val = strtoul(buf, NULL, 0);
+
+	return 0;
+}
+
+/* uio selects map N with an mmap offset of N pages */
+static int map_regions(int fd)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	char path[256];
+	unsigned long val;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_MAX_MAPS; i++) {
+		struct bench_map *m = &maps[i];
+
+		snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%u/name", uio_name, i);
+		if (read_sysfs(path, m->name, sizeof(m->name)))
+			break;
+
+		snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%u/size", uio_name, i);
+		if (read_sysfs_ul(path, &val))
+			break;
+		m->size = val;
+
+		snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%u/offset", uio_name, i);
+		m->offset = read_sysfs_ul(path, &val) ? 0 : val;
+
+		/* Only the status page is read-only */
+		m->base = mmap(NULL, m->size, strcmp(m->name, MACB_UIO_MAP_STATUS) ?
+			       PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, i * page);
+		if (m->base == MAP_FAILED) {
+			fprintf(stderr, "mmap of map%u (%s) failed: %s\n", i, m->name,
+				strerror(errno));
+			m->base = NULL;
+		}
+	}
+
+	nr_maps = i;
+
+	return nr_maps ? 0 : -ENOENT;
+}
+
+static struct bench_map *find_map(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_maps; i++) {
+		if (!strcmp(maps[i].name, name) && maps[i].base)
+			return &maps[i];
+	}
+
+	return NULL;
+}
+
+static volatile uint32_t *map_reg(struct bench_map *m, size_t offset)
+{
+	return (volatile uint32_t *)((char *)m->base + m->offset + offset);
+}
+
+static void bench_mmio(uint64_t *v)
+{
+	volatile uint32_t *reg, *idr, *mid;
+	struct bench_map *m;
+	char test[64];
+	unsigned int i, r;
+	uint64_t t;
+
+	for (r = 0; r < nr_regs; r++) {
+		m = find_map(regs[r].map);
+		if (!m || m->offset + regs[r].offset + 4 > m->size) {
+			fprintf(stderr, "No map %s covering %#zx\n", regs[r].map, regs[r].offset);
+			continue;
+		}
+
+		reg = map_reg(m, regs[r].offset);
+		for (i = 0; i < iterations; i++) {
+			t = now_ns();
+			(void)*reg;
+			v[i] = now_ns() - t;
+		}
+		snprintf(test, sizeof(test), "mmio_read %s+%#zx", regs[r].map, regs[r].offset);
+		report(test, v, iterations);
+	}
+
+	/* Writing 0 to IDR masks nothing, the read of MID makes it complete */
+	m = find_map(MACB_UIO_MAP_GEM);
+	if (!do_write || !m)
+		return;
+
+	idr = map_reg(m, GEM_IDR);
+	mid = map_reg(m, GEM_MID);
+	for (i = 0; i < iterations; i++) {
+		t = now_ns();
+		*idr = 0;
+		v[i] = now_ns() - t;
+	}
+	report("mmio_write_posted", v, iterations);
+
+	for (i = 0; i < iterations; i++) {
+		t = now_ns();
+		*idr = 0;
+		(void)*mid;
+		v[i] = now_ns() - t;
+	}
+	report("mmio_write_read", v, iterations);
+}
+
+/* Memory of the shared pages, as a floor for the MMIO numbers */
+static void bench_shared(uint64_t *v)
+{
+	struct macb_uio_link_status link;
+	struct bench_map *m;
+	unsigned int i;
+	uint64_t t;
+
+	m = find_map(MACB_UIO_MAP_STATUS);
+	if (!m)
+		return;
+
+	for (i = 0; i < iterations; i++) {
+		t = now_ns();
+		macb_uio_read_link_status(m->base, &link);
+		v[i] = now_ns() - t;
+	}
+	report("status_read_link", v, iterations);
+}
+
+static void bench_irqcontrol(int fd, uint64_t *v)
+{
+	uint32_t on;
+	unsigned int i, n = 0;
+	uint64_t t;
+
+	for (i = 0; i < iterations; i++) {
+		on = i & 1;
+		t = now_ns();
+		if (write(fd, &on, sizeof(on)) != sizeof(on)) {
+			fprintf(stderr, "irqcontrol write failed: %s\n", strerror(errno));
+			break;
+		}
+		v[n++] = now_ns() - t;
+	}
+
+	on = 0;
+	if (write(fd, &on, sizeof(on)) != sizeof(on))
+		n = 0;
+
+	report("irqcontrol_write", v, n);
+}
+
+static int wait_event(int fd, uint32_t *count)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int r;
+
+	r = poll(&pfd, 1, timeout_ms);
+	if (r <= 0)
+		return r ? -errno : -ETIMEDOUT;
+
+	if (read(fd, count, sizeof(*count)) != sizeof(*count))
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * The driver stamps every queue notification in the events page, the
+ * wakeup latency is the time from that stamp to read() returning.
+ * Needs traffic towards the port, the queue is re-armed every time.
+ */
+static void bench_wakeup(int fd, uint64_t *v)
+{
+	struct macb_uio_events *ev;
+	struct bench_map *m;
+	uint32_t on = 1, count;
+	unsigned int n = 0;
+	uint64_t t;
+
+	m = find_map(MACB_UIO_MAP_EVENTS);
+	if (!m) {
+		fprintf(stderr, "No events map, skipping wakeup\n");
+		return;
+	}
+	ev = m->base;
+
+	while (n < iterations) {
+		if (write(fd, &on, sizeof(on)) != sizeof(on))
+			break;
+		if (wait_event(fd, &count))
+			break;
+		t = now_ns();
+		if (!macb_uio_take_isr(ev, queue))
+			continue;
+		v[n++] = t - __atomic_load_n(&ev->queue[queue].notify_ns, __ATOMIC_RELAXED);
+	}
+
+	on = 0;
+	if (write(fd, &on, sizeof(on)) != sizeof(on))
+		n = 0;
+
+	report("irq_wakeup", v, n);
+}
+
+/*
+ * Link events from the time the driver saw the change to the wakeup,
+ * toggle the link partner while this runs. The detection delay itself
+ * depends on link_poll_min_ms/link_poll_max_ms or phylib.
+ */
+static void bench_link(int fd, uint64_t *v, unsigned int samples)
+{
+	struct macb_uio_events *ev;
+	struct bench_map *m;
+	uint32_t count;
+	unsigned int n = 0;
+	uint64_t t;
+
+	m = find_map(MACB_UIO_MAP_EVENTS);
+	if (!m) {
+		fprintf(stderr, "No events map, skipping link\n");
+		return;
+	}
+	ev = m->base;
+	macb_uio_take_sw_cause(ev);
+
+	while (n < samples) {
+		if (wait_event(fd, &count))
+			break;
+		t = now_ns();
+		if (!(macb_uio_take_sw_cause(ev) & MACB_UIO_EV_LINK))
+			continue;
+		v[n++] = t - __atomic_load_n(&ev->sw_notify_ns, __ATOMIC_RELAXED);
+	}
+
+	report("link_wakeup", v, n);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-d uioN] [-n iterations] [-q queue] [-i uioN] [-t timeout_ms]\n"
+	       "\t[-r map:offset]... [-w] [-l link_samples] [tests]\n"
+	       "\n"
+	       "tests: mmio shared irqcontrol wakeup link (default: mmio shared irqcontrol)\n"
+	       "\t-r\tregister to read in mmio, default macb_regs:0xfc (MID)\n"
+	       "\t-w\talso time writes of 0 to IDR in mmio\n"
+	       "\t-q\thw queue for wakeup\n"
+	       "\t-i\tuio device of that queue when it has its own (see queue_devices)\n"
+	       "\t-l\tnumber of link events to wait for in link (default 4)\n"
+	       "\nAll results are in ns.\n", prog);
+}
+
+static int has_test(int argc, char **argv, const char *name)
+{
+	int i;
+
+	if (optind >= argc)
+		return !strcmp(name, "mmio") || !strcmp(name, "shared") ||
+		       !strcmp(name, "irqcontrol");
+
+	for (i = optind; i < argc; i++) {
+		if (!strcmp(argv[i], name))
+			return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int link_samples = 4;
+	char path[64], *sep;
+	int fd, irq_fd, opt;
+	uint64_t *v;
+
+	while ((opt = getopt(argc, argv, "d:n:q:i:t:r:wl:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			uio_name = optarg;
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			queue = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			irq_uio_name = optarg;
+			break;
+		case 't':
+			timeout_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			sep = strchr(optarg, ':');
+			if (!sep || nr_regs == BENCH_MAX_REGS) {
+				usage(argv[0]);
+				return 1;
+			}
+			snprintf(regs[nr_regs].map, sizeof(regs[nr_regs].map), "%.*s",
+				 (int)(sep - optarg), optarg);
+			regs[nr_regs++].offset = strtoul(sep + 1, NULL, 0);
+			break;
+		case 'w':
+			do_write = 1;
+			break;
+		case 'l':
+			link_samples = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (!iterations || queue >= MACB_UIO_MAX_QUEUES) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!nr_regs) {
+		snprintf(regs[0].map, sizeof(regs[0].map), "%s", MACB_UIO_MAP_GEM);
+		regs[0].offset = GEM_MID;
+		nr_regs = 1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/%s", uio_name);
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	if (map_regions(fd)) {
+		fprintf(stderr, "No maps found for %s\n", uio_name);
+		return 1;
+	}
+
+	irq_fd = fd;
+	if (irq_uio_name) {
+		snprintf(path, sizeof(path), "/dev/%s", irq_uio_name);
+		irq_fd = open(path, O_RDWR);
+		if (irq_fd < 0) {
+			fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+			return 1;
+		}
+	}
+
+	v = calloc(iterations > link_samples ? iterations : link_samples, sizeof(*v));
+	if (!v)
+		return 1;
+
+	printf("%-28s %8s %8s %8s %8s %8s %8s %8s\n", "test", "n", "min", "p50",
+	       "p90", "p99", "p99.9", "max");
+
+	if (has_test(argc, argv, "mmio"))
+		bench_mmio(v);
+	if (has_test(argc, argv, "shared"))
+		bench_shared(v);
+	if (has_test(argc, argv, "irqcontrol"))
+		bench_irqcontrol(fd, v);
+	if (has_test(argc, argv, "wakeup"))
+		bench_wakeup(irq_fd, v);
+	if (has_test(argc, argv, "link"))
+		bench_link(fd, v, link_samples);
+
+	free(v);
+	if (irq_fd != fd)
+		close(irq_fd);
+	close(fd);
+
+	return 0;
+}
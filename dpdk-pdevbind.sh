@@ -2,13 +2,16 @@
 
 driver_supported=("macb_uio" "pdev_uio" "macb")
 
+# Attributes of macb_uio devices reported by --status, caps/ is added as a whole
+status_attrs=("pclk_hz" "phy_mode" "physical_addr" "dma_mask_bits" "dma_coherent" "cache_line_size" "desc_align" "dev_type" "speed_info" "queue_devices" "ring_addr" "ring_size" "pool_addr" "pool_size" "rx_coalesce_usecs" "tx_coalesce_usecs" "housekeeping_cpus" "ptp_index")
+
 print_err() {
 	printf "Error: argument error\n"
-	printf "Usage: ${0##*/} [-h|--help] [-q INTERFACE] [--query INTERFACE] [-b DRIVER DEVICE] [--bind DRIVER DEVICE] [-u DEVICE] [--unbind DEVICE]\n"
+	printf "Usage: ${0##*/} [-h|--help] [-q INTERFACE] [--query INTERFACE] [-b DRIVER DEVICE...] [--bind DRIVER DEVICE...] [-u DEVICE...] [--unbind DEVICE...] [-s|--status [--json]]\n"
 }
 
 print_usage() {
-	printf "Usage: ${0##*/} [-h|--help] [-q INTERFACE] [--query INTERFACE] [-b DRIVER DEVICE] [--bind DRIVER DEVICE] [-u DEVICE] [--unbind DEVICE]\n"
+	printf "Usage: ${0##*/} [-h|--help] [-q INTERFACE] [--query INTERFACE] [-b DRIVER DEVICE...] [--bind DRIVER DEVICE...] [-u DEVICE...] [--unbind DEVICE...] [-s|--status [--json]]\n"
 	printf "\nUtility to bind and unbind platform devices from Linux kernel\n"
 	printf "\npositional arguments:\n"
 	printf "\tDEVICE\t\t\tPlatform device can be queried through the interface\n"
@@ -16,11 +19,15 @@ print_usage() {
 	printf "\t-h, --help\t\tshow this help message and exit\n"
 	printf "\t-q, --query\t\tquery the platform device corresponding to the interface\n"
 	printf "\t-b, --bind\t\tselect the driver to use by device\n"
-	printf "\t-u, --unbind\t\tunbind a device\n"
+	printf "\t-u, --unbind\t\tunbind devices\n"
+	printf "\t-s, --status\t\tlist the platform GEMs with their driver, uio index, NUMA node and IRQs\n"
+	printf "\t--json\t\t\twith --status, print JSON including the macb_uio attributes\n"
 	printf "\nExamples:\n----------\n"
 	printf "\nTo query which platform device is used by the interface eth0:\n\t${0##*/} --query eth0\n"
 	printf "\nTo bind platform device (eg: 3200c000.ethernet) from the current driver to macb_uio\n\t${0##*/} --bind macb_uio 3200c000.ethernet\n"
+	printf "\nTo bind several platform devices to macb_uio at once:\n\t${0##*/} --bind macb_uio 3200c000.ethernet 3200e000.ethernet\n"
 	printf "\nTo unbind 3200c000.ethernet from using any driver:\n\t${0##*/} --unbind 3200c000.ethernet\n"
+	printf "\nTo list the platform GEMs as JSON:\n\t${0##*/} --status --json\n"
 	exit
 }
 
@@ -39,38 +46,133 @@ query() {
 	exit
 }
 
+check_devices() {
+	for dev in "$@"; do
+		if [ ! -d /sys/bus/platform/devices/$dev ];then
+			echo "There is no platform device named $dev"
+			exit
+		fi
+	done
+}
+
+# Everything is checked before the first device is unbound
 pdev_bind() {
-	if [[ ! $(echo "${driver_supported[@]}" | grep -w $1) ]];then
-		echo "The driver $1 is not supported"
+	drv=$1
+	shift
+	if [[ ! $(echo "${driver_supported[@]}" | grep -w $drv) ]];then
+		echo "The driver $drv is not supported"
 		exit
 	fi
-	if [ ! -d /sys/bus/platform/drivers/$1 ];then
-		echo "The driver $1 is not loaded"
+	if [ ! -d /sys/bus/platform/drivers/$drv ];then
+		echo "The driver $drv is not loaded"
 		exit
 	fi
-	if [ ! -d /sys/bus/platform/devices/$2 ];then
-		echo "There is no platform device named $2"
-		exit
-	fi
-	if [ -d /sys/bus/platform/devices/$2/driver ];then
-		echo $2 > /sys/bus/platform/devices/$2/driver/unbind
-	fi
-	echo $1 > /sys/bus/platform/devices/$2/driver_override
-	echo $2 > /sys/bus/platform/drivers/$1/bind
-	echo "Successfully bind platform device $2 to driver $1"
+	check_devices "$@"
+	for dev in "$@"; do
+		if [ -d /sys/bus/platform/devices/$dev/driver ];then
+			echo $dev > /sys/bus/platform/devices/$dev/driver/unbind
+		fi
+		echo $drv > /sys/bus/platform/devices/$dev/driver_override
+		echo $dev > /sys/bus/platform/drivers/$drv/bind 2>/dev/null
+		if [ "$(basename "$(readlink /sys/bus/platform/devices/$dev/driver)")" == "$drv" ];then
+			echo "Successfully bind platform device $dev to driver $drv"
+		else
+			echo "Failed to bind platform device $dev to driver $drv"
+		fi
+	done
 	exit
 }
 
 pdev_unbind() {
-	if [ ! -d /sys/bus/platform/devices/$1 ];then
-		echo "There is no platform device named $1"
-		exit
+	check_devices "$@"
+	for dev in "$@"; do
+		if [ -d /sys/bus/platform/devices/$dev/driver ];then
+			echo $dev > /sys/bus/platform/devices/$dev/driver/unbind
+		fi
+		echo "" > /sys/bus/platform/devices/$dev/driver_override
+		echo "Successfully unbind platform device $dev"
+	done
+	exit
+}
+
+# GEMs are recognised by their compatible, modalias or current driver
+is_gem() {
+	path=/sys/bus/platform/devices/$1
+	if [ -d $path/driver ] && [[ $(echo "${driver_supported[@]}" | grep -w "$(basename "$(readlink $path/driver)")") ]];then
+		return 0
 	fi
-	if [ -d /sys/bus/platform/devices/$1/driver ];then
-		echo $1 > /sys/bus/platform/devices/$1/driver/unbind
+	if [ -f $path/of_node/compatible ] && tr '\0' '\n' < $path/of_node/compatible | grep -qiE 'gem|macb';then
+		return 0
+	fi
+	grep -qiE 'gem|macb' $path/modalias 2>/dev/null
+}
+
+# IRQ numbers whose action is the device, or one of its interfaces
+dev_irqs() {
+	names="$1"
+	for net in /sys/bus/platform/devices/$1/net/*; do
+		[ -e "$net" ] && names="$names $(basename $net)"
+	done
+	for name in $names; do
+		awk -v n="$name" '$1 ~ /^[0-9]+:$/ { for (i = NF; i > 1; i--) if ($i == n || $i == n ",") { sub(":", "", $1); print $1; break } }' /proc/interrupts
+	done | sort -nu | tr '\n' ' ' | sed 's/ $//'
+}
+
+json_str() {
+	printf '"%s"' "$(printf '%s' "$1" | tr '\n' ' ' | sed -e 's/ $//' -e 's/\\/\\\\/g' -e 's/"/\\"/g')"
+}
+
+# The port's own uio device, the queue devices (macb_uio_qN) sit next to it
+port_uio() {
+	for u in $(ls -v $1/uio 2>/dev/null); do
+		if [ "$(cat /sys/class/uio/$u/name 2>/dev/null)" == "macb_uio" ];then
+			echo $u
+			return
+		fi
+	done
+	ls -v $1/uio 2>/dev/null | head -n 1
+}
+
+status() {
+	json=$1
+	first=1
+	[ "$json" ] && printf "[\n"
+	[ "$json" ] || printf "%-24s %-10s %-6s %-5s %s\n" DEVICE DRIVER UIO NUMA IRQS
+	for path in /sys/bus/platform/devices/*; do
+		dev=$(basename $path)
+		is_gem $dev || continue
+		drv=none
+		[ -d $path/driver ] && drv=$(basename "$(readlink $path/driver)")
+		uio=$(port_uio $path)
+		uio=${uio:-none}
+		numa=$(cat $path/numa_node 2>/dev/null)
+		numa=${numa:--1}
+		irqs=$(dev_irqs $dev)
+		if [ ! "$json" ];then
+			printf "%-24s %-10s %-6s %-5s %s\n" $dev $drv $uio $numa "${irqs:-none}"
+			continue
+		fi
+		[ $first -eq 1 ] || printf ",\n"
+		first=0
+		printf '  {"device": %s, "driver": %s, "uio": %s, "numa_node": %s, "irqs": [%s]' \
+			"$(json_str $dev)" "$(json_str $drv)" "$(json_str $uio)" $numa "$(echo $irqs | sed 's/ /, /g')"
+		for attr in "${status_attrs[@]}"; do
+			[ -r $path/$attr ] && printf ', %s: %s' "$(json_str $attr)" "$(json_str "$(cat $path/$attr 2>/dev/null)")"
+		done
+		if [ -d $path/caps ];then
+			printf ', "caps": {'
+			sep=""
+			for cap in $path/caps/*; do
+				printf '%s%s: %s' "$sep" "$(json_str $(basename $cap))" "$(json_str "$(cat $cap 2>/dev/null)")"
+				sep=", "
+			done
+			printf '}'
+		fi
+		printf '}'
+	done
+	if [ "$json" ];then
+		[ $first -eq 1 ] && printf "]\n" || printf "\n]\n"
 	fi
-	echo "" > /sys/bus/platform/devices/$1/driver_override
-	echo "Successfully unbind platform device $1"
 	exit
 }
 
@@ -82,12 +184,20 @@ if [[ "$#" -eq 2 && ("$1" == "-q" || "$1" == "--query") ]];then
 	query $2
 fi
 
-if [[ "$#" -eq 3 && ("$1" == "-b" || "$1" == "--bind") ]];then
-	pdev_bind $2 $3
+if [[ "$#" -ge 3 && ("$1" == "-b" || "$1" == "--bind") ]];then
+	pdev_bind "${@:2}"
+fi
+
+if [[ "$#" -ge 2 && ("$1" == "-u" || "$1" == "--unbind") ]];then
+	pdev_unbind "${@:2}"
+fi
+
+if [[ "$#" -eq 1 && ("$1" == "-s" || "$1" == "--status") ]];then
+	status
 fi
 
-if [[ "$#" -eq 2 && ("$1" == "-u" || "$1" == "--unbind") ]];then
-	pdev_unbind $2
+if [[ "$#" -eq 2 && ("$1" == "-s" || "$1" == "--status") && "$2" == "--json" ]];then
+	status json
 fi
 
 print_err
@@ -2,22 +2,47 @@
 /* Copyright(c) 2022 - 2025 Phytium Technology Co., Ltd. */
 
 #include <linux/clk.h>
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/dma-direct.h>
 #include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/of_mdio.h>
 #include <linux/phy.h>
+#include <linux/percpu.h>
 #include <linux/platform_device.h>
+#include <linux/poll.h>
 #include <linux/property.h>
+#include <linux/ptp_clock_kernel.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
 #include <linux/uio_driver.h>
 #include <linux/version.h>
-#include <linux/kthread.h>
+#include <linux/workqueue.h>
 #include <linux/of.h>
+#include <linux/of_address.h>
 #include <linux/acpi.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+#include <linux/dma-map-ops.h>
+#else
+#include <linux/dma-noncoherent.h>
+#endif
 
+#include "macb_uio.h"
+
+#define CREATE_TRACE_POINTS
+#include "macb_uio_trace.h"
 
 #define DRIVER_NAME "macb_uio"
 #define DRIVER_VERSION "5.0"
@@ -25,6 +50,422 @@
 #define DRIVER_DESC "UIO driver for platform device"
 
 #define UIO_POLL_INTERVAL 100 /* Unit: ms */
+#define MACB_UIO_POLL_SLACK 10 /* Unit: ms */
+#define MACB_UIO_STATS_INTERVAL 1000 /* Unit: ms */
+#define MACB_UIO_HIST_BUCKETS 32 /* log2 of ns */
+#define MACB_MDIO_TIMEOUT 1000000 /* Unit: us */
+
+/* GEM register offsets */
+#define MACB_NCR	0x0000 /* Network Control */
+#define MACB_NCFGR	0x0004 /* Network Config */
+#define MACB_NSR	0x0008 /* Network Status */
+#define MACB_USRIO	0x000c /* User IO */
+#define GEM_DMACFG	0x0010 /* DMA Configuration */
+#define MACB_TSR	0x0014 /* Transmit Status */
+#define MACB_RBQP	0x0018 /* RX Queue Base Address */
+#define MACB_TBQP	0x001c /* TX Queue Base Address */
+#define MACB_RSR	0x0020 /* Receive Status */
+#define MACB_ISR	0x0024 /* Interrupt Status */
+#define MACB_IER	0x0028 /* Interrupt Enable */
+#define MACB_IDR	0x002c /* Interrupt Disable */
+#define MACB_IMR	0x0030 /* Interrupt Mask */
+#define MACB_MAN	0x0034 /* PHY Maintenance */
+#define GEM_JML		0x0048 /* Jumbo Max Length */
+#define GEM_HS_MAC_CONFIG	0x0050 /* High speed MAC config */
+#define GEM_INTMOD	0x005c /* Interrupt Moderation */
+#define MACB_MID	0x00fc /* Module ID */
+#define GEM_OTX		0x0100 /* First statistics register */
+#define GEM_TISUBN	0x01bc /* 1588 Timer Increment Sub-ns */
+#define GEM_TSH		0x01c0 /* 1588 Timer Seconds High */
+#define GEM_TSL		0x01d0 /* 1588 Timer Seconds Low */
+#define GEM_TN		0x01d4 /* 1588 Timer Nanoseconds */
+#define GEM_TA		0x01d8 /* 1588 Timer Adjust */
+#define GEM_TI		0x01dc /* 1588 Timer Increment */
+#define GEM_DCFG1	0x0280 /* Design Config 1 */
+#define GEM_DCFG2	0x0284 /* Design Config 2 */
+#define GEM_DCFG5	0x0290 /* Design Config 5 */
+#define GEM_DCFG6	0x0294 /* Design Config 6 */
+#define GEM_DCFG8	0x029c /* Design Config 8 */
+#define GEM_DCFG12	0x02ac /* Design Config 12 */
+#define GEM_TBQPH	0x04c8 /* TX Queue Base Address High */
+#define GEM_RBQPH	0x04d4 /* RX Queue Base Address High */
+#define GEM_USX_CONTROL	0x0a80 /* High speed PCS control */
+#define GEM_USX_STATUS	0x0a88 /* High speed PCS status */
+
+/* Per-queue interrupt registers, hw_q starts at 0 for queue 1 */
+#define GEM_ISR(hw_q)	(0x0400 + ((hw_q) << 2))
+#define GEM_IER(hw_q)	(0x0600 + ((hw_q) << 2))
+#define GEM_IDR(hw_q)	(0x0620 + ((hw_q) << 2))
+#define GEM_IMR(hw_q)	(0x0640 + ((hw_q) << 2))
+#define GEM_TBQP(hw_q)	(0x0440 + ((hw_q) << 2))
+#define GEM_RBQP(hw_q)	(0x0480 + ((hw_q) << 2))
+
+/* Bitfields in NCR */
+#define MACB_RE_OFFSET		2 /* receive enable */
+#define MACB_TE_OFFSET		3 /* transmit enable */
+#define MACB_MPE_OFFSET		4 /* management port enable */
+#define GEM_ENABLE_HS_MAC_OFFSET	31
+
+/* Bitfields in NCFGR */
+#define MACB_SPD_OFFSET		0 /* 100 Mbps */
+#define MACB_FD_OFFSET		1 /* full duplex */
+#define GEM_GBE_OFFSET		10 /* gigabit */
+#define MACB_PAE_OFFSET		13 /* pause enable */
+#define GEM_CLK_OFFSET		18 /* MDC clock division */
+#define GEM_CLK_SIZE		3
+
+#define GEM_CLK_DIV8		0
+#define GEM_CLK_DIV16		1
+#define GEM_CLK_DIV32		2
+#define GEM_CLK_DIV48		3
+#define GEM_CLK_DIV64		4
+#define GEM_CLK_DIV96		5
+#define GEM_CLK_DIV128		6
+#define GEM_CLK_DIV224		7
+
+/* Bitfields in NSR */
+#define MACB_NSR_LINK_OFFSET	0
+#define MACB_IDLE_OFFSET	2 /* PHY management is idle */
+
+/* Bitfields in DMACFG */
+#define GEM_FBLDO_OFFSET	0 /* fixed burst length */
+#define GEM_FBLDO_SIZE		5
+#define GEM_RXBS_OFFSET		16 /* RX buffer size in 64 bytes */
+#define GEM_RXBS_SIZE		8
+#define GEM_ADDR64_OFFSET	30
+
+/* Bitfields in TSR */
+#define MACB_TGO_OFFSET		3 /* transmit go */
+
+/* Bitfields in RSR */
+#define MACB_BNA_OFFSET		0 /* buffer not available */
+#define MACB_RSR_OVR_OFFSET	2 /* receive overrun */
+
+/* Bitfields in MAN */
+#define MACB_DATA_OFFSET	0
+#define MACB_DATA_SIZE		16
+#define MACB_CODE_OFFSET	16
+#define MACB_CODE_SIZE		2
+#define MACB_REGA_OFFSET	18
+#define MACB_REGA_SIZE		5
+#define MACB_PHYA_OFFSET	23
+#define MACB_PHYA_SIZE		5
+#define MACB_RW_OFFSET		28
+#define MACB_RW_SIZE		2
+#define MACB_SOF_OFFSET		30
+#define MACB_SOF_SIZE		2
+
+#define MACB_MAN_C22_SOF	1
+#define MACB_MAN_C22_WRITE	1
+#define MACB_MAN_C22_READ	2
+#define MACB_MAN_C22_CODE	2
+
+#define MACB_MAN_C45_SOF	0
+#define MACB_MAN_C45_ADDR	0
+#define MACB_MAN_C45_WRITE	1
+#define MACB_MAN_C45_POST_READ_INCR	2
+#define MACB_MAN_C45_READ	3
+#define MACB_MAN_C45_CODE	2
+
+/* Bitfields in HS_MAC_CONFIG */
+#define GEM_HS_MAC_SPEED_OFFSET	0
+#define GEM_HS_MAC_SPEED_SIZE	3
+
+#define HS_SPEED_100M		0
+#define HS_SPEED_1000M		1
+#define HS_SPEED_2500M		2
+#define HS_SPEED_5000M		3
+#define HS_SPEED_10000M		4
+
+/* Bitfields in INTMOD, counted in units of MACB_INTMOD_UNIT_NS */
+#define GEM_RX_MODER_OFFSET	0
+#define GEM_RX_MODER_SIZE	8
+#define GEM_TX_MODER_OFFSET	16
+#define GEM_TX_MODER_SIZE	8
+
+#define MACB_INTMOD_UNIT_NS	800
+
+/* Bitfields in ISR/IER/IDR/IMR */
+#define MACB_RCOMP_OFFSET	1 /* receive complete */
+#define MACB_ISR_ROVR_OFFSET	10 /* receive overrun */
+
+/* Bitfields in MID */
+#define MACB_IDNUM_OFFSET	16
+#define MACB_IDNUM_SIZE		12
+
+/* Bitfields in JML */
+#define GEM_JML_SIZE_OFFSET	0
+#define GEM_JML_SIZE_SIZE	14
+
+/* Bitfields in DCFG1 */
+#define GEM_NO_PCS_OFFSET	0
+#define GEM_IRQCOR_OFFSET	23 /* interrupt status is clear on read */
+#define GEM_DBWDEF_OFFSET	25 /* data bus width */
+#define GEM_DBWDEF_SIZE		3
+
+/* Bitfields in DCFG2 */
+#define GEM_RX_PKT_BUFF_OFFSET	20
+#define GEM_TX_PKT_BUFF_OFFSET	21
+#define GEM_RX_PBUF_ADDR_OFFSET	22
+#define GEM_RX_PBUF_ADDR_SIZE	4
+#define GEM_TX_PBUF_ADDR_OFFSET	26
+#define GEM_TX_PBUF_ADDR_SIZE	4
+
+/* Bitfields in DCFG5 */
+#define GEM_TSU_OFFSET		8
+
+/* Bitfields in DCFG6 */
+#define GEM_DAW64_OFFSET	23 /* 64-bit addressing */
+#define GEM_PBUF_CUTTHRU_OFFSET	25
+#define GEM_PBUF_RSC_OFFSET	26
+#define GEM_PBUF_LSO_OFFSET	27
+
+/* Bitfields in DCFG8 */
+#define GEM_T2SCR_OFFSET	16
+#define GEM_T2SCR_SIZE		8
+#define GEM_T1SCR_OFFSET	24
+#define GEM_T1SCR_SIZE		8
+
+/* Bitfields in DCFG12 */
+#define GEM_HIGH_SPEED_OFFSET	26
+
+/* Bitfields in TISUBN */
+#define GEM_SUBNSINCRL_OFFSET	24
+#define GEM_SUBNSINCRL_SIZE	8
+#define GEM_SUBNSINCRH_OFFSET	0
+#define GEM_SUBNSINCRH_SIZE	16
+#define GEM_SUBNSINCR_SIZE	24
+
+/* Bitfields in TI */
+#define GEM_NSINCR_OFFSET	0
+#define GEM_NSINCR_SIZE		8
+
+/* Bitfields in TSH/TSL/TN/TA */
+#define GEM_TSH_SIZE		16
+#define GEM_TSL_SIZE		32
+#define GEM_TN_SIZE		30
+#define GEM_ITDT_OFFSET		0 /* increment to add or subtract */
+#define GEM_ITDT_SIZE		30
+#define GEM_ADDSUB_OFFSET	31 /* subtract */
+
+#define MACB_TSU_SEC_MAX	GENMASK_ULL(GEM_TSH_SIZE + GEM_TSL_SIZE - 1, 0)
+#define MACB_TSU_NSEC_MAX	GENMASK(GEM_TN_SIZE - 1, 0)
+#define MACB_TSU_MAX_ADJ	64000000 /* ppb */
+
+/* Bitfields in USX_CONTROL */
+#define GEM_USX_CTRL_SPEED_OFFSET	14
+#define GEM_USX_CTRL_SPEED_SIZE		3
+
+#define MACB_BIT(name)	BIT(MACB_##name##_OFFSET)
+#define GEM_BIT(name)	BIT(GEM_##name##_OFFSET)
+#define MACB_BFEXT(name, value) \
+	(((value) >> MACB_##name##_OFFSET) & GENMASK(MACB_##name##_SIZE - 1, 0))
+#define GEM_BFEXT(name, value) \
+	(((value) >> GEM_##name##_OFFSET) & GENMASK(GEM_##name##_SIZE - 1, 0))
+#define MACB_BF(name, value) \
+	(((value) & GENMASK(MACB_##name##_SIZE - 1, 0)) << MACB_##name##_OFFSET)
+#define GEM_BF(name, value) \
+	(((value) & GENMASK(GEM_##name##_SIZE - 1, 0)) << GEM_##name##_OFFSET)
+#define GEM_BFINS(name, value, old) \
+	(((old) & ~(GENMASK(GEM_##name##_SIZE - 1, 0) << GEM_##name##_OFFSET)) | \
+	 (((value) & GENMASK(GEM_##name##_SIZE - 1, 0)) << GEM_##name##_OFFSET))
+
+#define MACB_RX_INT_FLAGS	(MACB_BIT(RCOMP) | MACB_BIT(ISR_ROVR))
+
+#define macb_uio_readl(udev, reg)	readl_relaxed((udev)->regs + (reg))
+#define macb_uio_writel(udev, reg, value) \
+	writel_relaxed((value), (udev)->regs + (reg))
+
+static bool force_poll;
+module_param(force_poll, bool, 0444);
+MODULE_PARM_DESC(force_poll,
+		 "Notify userspace every 100 ms whether or not the link changed");
+
+static unsigned int link_poll_min_ms = 20;
+module_param(link_poll_min_ms, uint, 0644);
+MODULE_PARM_DESC(link_poll_min_ms,
+		 "Link poll interval right after open or a link change (ms)");
+
+static unsigned int link_poll_max_ms = 1000;
+module_param(link_poll_max_ms, uint, 0644);
+MODULE_PARM_DESC(link_poll_max_ms,
+		 "Link poll interval once the link has been stable (ms)");
+
+static unsigned int irq_sources = MACB_RX_INT_FLAGS;
+module_param(irq_sources, uint, 0444);
+MODULE_PARM_DESC(irq_sources,
+		 "Interrupt sources armed by writing 1 to /dev/uioX (default: RCOMP | ROVR)");
+
+static bool phy_manage;
+module_param(phy_manage, bool, 0444);
+MODULE_PARM_DESC(phy_manage,
+		 "Drive the MDIO bus and the PHY from the kernel, userspace must not use MDIO");
+
+static bool phy_early_start;
+module_param(phy_early_start, bool, 0444);
+MODULE_PARM_DESC(phy_early_start,
+		 "With phy_manage, start autonegotiation at probe and keep the link up across close");
+
+static unsigned int ring_size = 16384;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size,
+		 "Bytes of each RX and TX descriptor ring in the \"rings\" map, 0 disables the map");
+
+static unsigned int pool_size;
+module_param(pool_size, uint, 0444);
+MODULE_PARM_DESC(pool_size,
+		 "MiB of contiguous DMA memory exported as the \"pool\" map, 0 disables the map");
+
+static char *housekeeping_cpus;
+module_param(housekeeping_cpus, charp, 0444);
+MODULE_PARM_DESC(housekeeping_cpus,
+		 "CPU list for link polling and IRQ affinity hints (default: CPUs of the device NUMA node)");
+
+static bool stats_accumulate;
+module_param(stats_accumulate, bool, 0444);
+MODULE_PARM_DESC(stats_accumulate,
+		 "Fold the GEM statistics registers into the \"status\" map, userspace must not read them");
+
+static unsigned int watchdog_ms;
+module_param(watchdog_ms, uint, 0444);
+MODULE_PARM_DESC(watchdog_ms,
+		 "Report a TX queue stuck for this long and RX overruns in \"events\" (ms), 0 disables");
+
+static bool ptp_clock = true;
+module_param(ptp_clock, bool, 0444);
+MODULE_PARM_DESC(ptp_clock,
+		 "Register the GEM timestamp unit as a PTP clock, userspace must not write the TSU");
+
+static char *regs_mapping = "strict";
+module_param(regs_mapping, charp, 0444);
+MODULE_PARM_DESC(regs_mapping,
+		 "Attributes of the register maps: strict (nGnRnE, default) or device (nGnRE)");
+
+static bool persist;
+module_param(persist, bool, 0444);
+MODULE_PARM_DESC(persist,
+		 "Keep the MAC, rings, link polling and PMD state running across the last close");
+
+static char *claim;
+module_param(claim, charp, 0444);
+MODULE_PARM_DESC(claim,
+		 "Comma separated device names, compatibles or ACPI HIDs to take over at load");
+
+static bool queue_uio;
+module_param(queue_uio, bool, 0444);
+MODULE_PARM_DESC(queue_uio,
+		 "Register a separate uio device for each additional GEM queue (default off)");
+
+struct rte_uio_platform_dev;
+struct macb_uio_poll_engine;
+
+struct macb_uio_link {
+	bool up;
+	unsigned int pause; /* MACB_UIO_PAUSE_* */
+	int speed;
+	int duplex;
+};
+
+struct fixed_phy_status {
+	int speed;
+	int duplex;
+};
+
+enum macb_uio_map_type {
+	MACB_UIO_MAP_REGS,	/* device registers */
+	MACB_UIO_MAP_PAGE,	/* read-only kernel page */
+	MACB_UIO_MAP_SHARED,	/* read-write kernel page */
+	MACB_UIO_MAP_DMA,	/* dma_alloc_coherent() region */
+};
+
+static const char * const macb_uio_prot_names[] = {
+	[MACB_UIO_PROT_DEVICE] = "device",
+	[MACB_UIO_PROT_STRICT] = "strict",
+	[MACB_UIO_PROT_WC] = "wc",
+	[MACB_UIO_PROT_CACHED] = "cached",
+	[MACB_UIO_PROT_DMA] = "dma",
+};
+
+/**
+ * A coherent DMA allocation exported to userspace. Every VMA holds a
+ * reference next to the driver's, so a region still mapped by a PMD
+ * outlives remove and is freed when the last mapping goes away.
+ */
+struct macb_uio_dma_mem {
+	struct kref ref;
+	struct device *dev;
+	void *cpu_addr;
+	dma_addr_t dma_addr;
+	size_t size;
+};
+
+struct macb_uio_map {
+	enum macb_uio_map_type type;
+	enum macb_uio_prot prot;
+	void *cpu_addr;
+	dma_addr_t dma_addr;
+	struct macb_uio_dma_mem *dmem; /* MACB_UIO_MAP_DMA only */
+};
+
+/**
+ * Hardware capabilities decoded from the GEM design config registers.
+ */
+struct macb_uio_caps {
+	bool is_gem;
+	u32 queue_mask;
+	unsigned int num_queues;
+	unsigned int dbw_bytes;
+	u32 tx_pbuf_size;
+	u32 rx_pbuf_size;
+	u32 jumbo_max_len;
+	unsigned int t1_screeners;
+	unsigned int t2_screeners;
+	bool irq_cor;
+	bool pcs;
+	bool lso;
+	bool rsc;
+	bool cut_thru;
+	bool dma64;
+	bool tsu;
+	bool high_speed;
+};
+
+struct macb_uio_dma {
+	void *cpu_addr;
+	dma_addr_t dma_addr;
+	size_t size;
+	struct macb_uio_dma_mem *dmem;
+};
+
+/**
+ * A structure describing one hardware interrupt of a GEM queue.
+ */
+struct macb_uio_queue {
+	struct rte_uio_platform_dev *udev;
+	struct uio_info info;
+	char name[16];
+	bool has_uio;
+	unsigned int index;
+	int irq;
+	unsigned int isr;
+	unsigned int ier;
+	unsigned int idr;
+	unsigned int imr;
+	u64 notify_ns; /* last notification not yet followed by a re-arm */
+};
+
+/*
+ * Debugfs counters. Histogram bucket N counts latencies in
+ * [2^(N-1), 2^N) ns, the first and last buckets are open ended.
+ */
+struct macb_uio_dbg {
+	struct dentry *dir;
+	atomic64_t events;	/* notifications raised to userspace */
+	atomic64_t spurious;	/* interrupts without an unmasked cause */
+	atomic64_t coalesced;	/* causes merged into ones not yet taken */
+	atomic64_t irq_to_notify[MACB_UIO_HIST_BUCKETS];
+	atomic64_t notify_to_arm[MACB_UIO_HIST_BUCKETS];
+};
 
 /**
  * A structure describing the private information for a uio device.
@@ -33,7 +474,57 @@ struct rte_uio_platform_dev {
 	struct uio_info info;
 	struct platform_device *pdev;
 	atomic_t refcnt;
-	struct task_struct *poll_task;
+	struct list_head subscribers; /* macb_uio_ctl_file, under macb_uio_sub_lock */
+	struct list_head poll_node;
+	unsigned int poll_interval; /* Unit: ms */
+	unsigned long poll_next; /* jiffies */
+	struct macb_uio_poll_engine *engine;
+	cpumask_var_t hk_mask;
+	struct macb_uio_link link;
+	struct macb_uio_status *status;
+	struct macb_uio_events *events;
+	spinlock_t status_lock; /* serializes writers of the status page */
+	bool fixed_link;
+	struct fixed_phy_status fixed_status;
+	struct mii_bus *mii_bus;
+	struct phy_device *phydev;
+	bool phy_started;
+	struct list_head phy_node;
+	void __iomem *regs;
+	unsigned int nr_maps;
+	struct macb_uio_map maps[MAX_UIO_MAPS];
+	enum macb_uio_prot regs_prot;
+	char regs_names[MAX_UIO_MAPS][8]; /* "regsN" for blocks without reg-names */
+	struct macb_uio_dma rings;
+	size_t ring_size;
+	struct macb_uio_dma pool;
+	struct miscdevice ctl;
+	struct ptp_clock *ptp;
+	struct ptp_clock_info ptp_info;
+	spinlock_t tsu_lock; /* serializes TSU register sequences */
+	u32 tsu_incr; /* nominal ns << GEM_SUBNSINCR_SIZE | sub_ns */
+	char ctl_name[32];
+	/* Resolved once at probe, see macb_uio_setup_desc() */
+	unsigned long pclk_hz;
+	char dev_type[64];
+	char phy_mode[32];
+	phys_addr_t physical_addr;
+	struct macb_uio_desc desc;
+	struct macb_uio_caps caps;
+	spinlock_t irq_lock; /* serializes IER/IDR between top half and irqcontrol */
+	unsigned int dma_mask_bits;
+	bool dma_coherent;
+	unsigned int cache_line_size;
+	unsigned int desc_align;
+	unsigned int rx_coalesce_usecs;
+	unsigned int tx_coalesce_usecs;
+	unsigned int nr_irqs;
+	struct macb_uio_queue queues[MACB_UIO_MAX_QUEUES];
+	struct macb_uio_dbg dbg;
+	u32 wd_tbqp[MACB_UIO_MAX_QUEUES];
+	unsigned long wd_stall_since; /* jiffies */
+	bool wd_stalled;
+	bool wd_tx_hung;
 };
 
 struct macb_platform_data {
@@ -41,180 +532,2855 @@ struct macb_platform_data {
 	struct clk *hclk;
 };
 
-struct fixed_phy_status {
-	int speed;
-	int duplex;
-};
+/* Parse the firmware "fixed-link" node, returns -ENODEV if there is none */
+static int macb_uio_get_fixed_link(struct device *dev,
+								   struct fixed_phy_status *status)
+{
+	struct fwnode_handle *fwnode = dev_fwnode(dev);
+	struct fwnode_handle *fixed_node;
+
+	if (!fwnode)
+		return -ENODEV;
+
+	fixed_node = fwnode_get_named_child_node(fwnode, "fixed-link");
+	if (!fixed_node)
+		return -ENODEV;
+
+	fwnode_property_read_u32(fixed_node, "speed", &status->speed);
+
+	status->duplex = DUPLEX_HALF;
+	if (fwnode_property_read_bool(fixed_node, "full-duplex"))
+		status->duplex = DUPLEX_FULL;
+
+	fwnode_handle_put(fixed_node);
+
+	return 0;
+}
+
+
+static ssize_t dev_type_show(struct device *dev, struct device_attribute *attr,
+							 char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 64, "%s", udev->dev_type);
+}
+
+static DEVICE_ATTR_RO(dev_type);
+
+/* sriov sysfs */
+static ssize_t pclk_hz_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 12, "%lu", udev->pclk_hz);
+}
+
+static DEVICE_ATTR_RO(pclk_hz);
+
+static ssize_t phy_mode_show(struct device *dev, struct device_attribute *attr,
+							 char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 64, "%s", udev->phy_mode);
+}
+
+static DEVICE_ATTR_RO(phy_mode);
+
+static ssize_t physical_addr_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "0x%llx", (unsigned long long)udev->physical_addr);
+}
+
+static DEVICE_ATTR_RO(physical_addr);
+
+static ssize_t dma_mask_bits_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 8, "%u\n", udev->dma_mask_bits);
+}
+
+static DEVICE_ATTR_RO(dma_mask_bits);
+
+static ssize_t dma_coherent_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 8, "%d\n", udev->dma_coherent);
+}
+
+static DEVICE_ATTR_RO(dma_coherent);
+
+static ssize_t cache_line_size_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "%u\n", udev->cache_line_size);
+}
+
+static DEVICE_ATTR_RO(cache_line_size);
+
+static ssize_t desc_align_show(struct device *dev, struct device_attribute *attr,
+							char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "%u\n", udev->desc_align);
+}
+
+static DEVICE_ATTR_RO(desc_align);
+
+static ssize_t speed_info_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	if (udev->phydev) {
+		if (!udev->link.up)
+			return snprintf(buf, 64, "phy:link-down\n");
+
+		return snprintf(buf, 64, "phy:%d %s-duplex\n", udev->link.speed,
+				udev->link.duplex == DUPLEX_FULL ? "full" : "half");
+	}
+
+	if (!udev->fixed_link)
+		return snprintf(buf, 64, "unknown");
+
+	if (udev->fixed_status.duplex == DUPLEX_FULL)
+		return snprintf(buf, 64, "fixed-link:%d full-duplex\n",
+				udev->fixed_status.speed);
+	else
+		return snprintf(buf, 64, "fixed-link:%d half-duplex\n",
+				udev->fixed_status.speed);
+}
+
+static DEVICE_ATTR_RO(speed_info);
+
+static ssize_t queue_devices_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+	struct macb_uio_queue *queue;
+	ssize_t len = 0;
+	unsigned int i;
+
+	if (!udev)
+		return -ENODEV;
+
+	for (i = 0; i < udev->nr_irqs; i++) {
+		queue = &udev->queues[i];
+		if (queue->has_uio)
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%u uio%d\n",
+					 queue->index, queue->info.uio_dev->minor);
+	}
+
+	return len;
+}
+
+static DEVICE_ATTR_RO(queue_devices);
+
+static ssize_t ring_addr_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev || !udev->rings.cpu_addr)
+		return -ENODEV;
+
+	return snprintf(buf, 24, "0x%llx\n", (unsigned long long)udev->rings.dma_addr);
+}
+
+static DEVICE_ATTR_RO(ring_addr);
+
+static ssize_t ring_size_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev || !udev->rings.cpu_addr)
+		return -ENODEV;
+
+	return snprintf(buf, 24, "%zu\n", udev->ring_size);
+}
+
+static DEVICE_ATTR_RO(ring_size);
+
+static ssize_t pool_addr_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev || !udev->pool.cpu_addr)
+		return -ENODEV;
+
+	return snprintf(buf, 24, "0x%llx\n", (unsigned long long)udev->pool.dma_addr);
+}
+
+static DEVICE_ATTR_RO(pool_addr);
+
+static ssize_t pool_size_show(struct device *dev, struct device_attribute *attr,
+						char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev || !udev->pool.cpu_addr)
+		return -ENODEV;
+
+	return snprintf(buf, 24, "%zu\n", udev->pool.size);
+}
+
+static DEVICE_ATTR_RO(pool_size);
+
+/*
+ * Program the moderation timers. The hardware holds a completion
+ * interrupt back until the timer expires, so a burst raises one
+ * interrupt instead of one per frame.
+ */
+static void macb_uio_set_coalesce(struct rte_uio_platform_dev *udev)
+{
+	unsigned long flags;
+	u32 intmod;
+
+	if (!udev->regs || !udev->caps.is_gem)
+		return;
+
+	spin_lock_irqsave(&udev->irq_lock, flags);
+	intmod = macb_uio_readl(udev, GEM_INTMOD);
+	intmod = GEM_BFINS(RX_MODER, udev->rx_coalesce_usecs * 1000 /
+			   MACB_INTMOD_UNIT_NS, intmod);
+	intmod = GEM_BFINS(TX_MODER, udev->tx_coalesce_usecs * 1000 /
+			   MACB_INTMOD_UNIT_NS, intmod);
+	macb_uio_writel(udev, GEM_INTMOD, intmod);
+	spin_unlock_irqrestore(&udev->irq_lock, flags);
+}
+
+static ssize_t macb_uio_store_coalesce(struct device *dev, const char *buf,
+									   size_t count, bool rx)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+	unsigned int usecs;
+	int err;
+
+	if (!udev)
+		return -ENODEV;
+
+	err = kstrtouint(buf, 0, &usecs);
+	if (err)
+		return err;
+
+	/* Both timers are 8 bits wide, that is at most 204 us */
+	if (usecs > GENMASK(GEM_RX_MODER_SIZE - 1, 0) * MACB_INTMOD_UNIT_NS / 1000)
+		return -ERANGE;
+
+	if (rx)
+		udev->rx_coalesce_usecs = usecs;
+	else
+		udev->tx_coalesce_usecs = usecs;
+	macb_uio_set_coalesce(udev);
+
+	return count;
+}
+
+static ssize_t rx_coalesce_usecs_show(struct device *dev,
+						struct device_attribute *attr, char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "%u\n", udev->rx_coalesce_usecs);
+}
+
+static ssize_t rx_coalesce_usecs_store(struct device *dev,
+						struct device_attribute *attr, const char *buf, size_t count)
+{
+	return macb_uio_store_coalesce(dev, buf, count, true);
+}
+
+static DEVICE_ATTR_RW(rx_coalesce_usecs);
+
+static ssize_t tx_coalesce_usecs_show(struct device *dev,
+						struct device_attribute *attr, char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "%u\n", udev->tx_coalesce_usecs);
+}
+
+static ssize_t tx_coalesce_usecs_store(struct device *dev,
+						struct device_attribute *attr, const char *buf, size_t count)
+{
+	return macb_uio_store_coalesce(dev, buf, count, false);
+}
+
+static DEVICE_ATTR_RW(tx_coalesce_usecs);
+
+static void macb_uio_set_irq_affinity(struct rte_uio_platform_dev *udev);
+
+/* Protects every poll engine list and the housekeeping masks */
+static DEFINE_MUTEX(macb_uio_poll_lock);
+
+static ssize_t housekeeping_cpus_show(struct device *dev,
+						struct device_attribute *attr, char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+	ssize_t len;
+
+	if (!udev)
+		return -ENODEV;
+
+	mutex_lock(&macb_uio_poll_lock);
+	len = snprintf(buf, PAGE_SIZE, "%*pbl\n", cpumask_pr_args(udev->hk_mask));
+	mutex_unlock(&macb_uio_poll_lock);
+
+	return len;
+}
+
+/* Applies to the IRQ hints at once and to link polling on the next open */
+static ssize_t housekeeping_cpus_store(struct device *dev,
+						struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+	cpumask_var_t mask;
+	int err;
+
+	if (!udev)
+		return -ENODEV;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = cpulist_parse(buf, mask);
+	if (!err && !cpumask_intersects(mask, cpu_online_mask))
+		err = -EINVAL;
+	if (!err) {
+		/* CPU hotplug picks a new engine CPU from the mask */
+		mutex_lock(&macb_uio_poll_lock);
+		cpumask_copy(udev->hk_mask, mask);
+		mutex_unlock(&macb_uio_poll_lock);
+		macb_uio_set_irq_affinity(udev);
+	}
+
+	free_cpumask_var(mask);
+
+	return err ? err : count;
+}
+
+static DEVICE_ATTR_RW(housekeeping_cpus);
+
+static ssize_t ptp_index_show(struct device *dev,
+						struct device_attribute *attr, char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+
+	if (!udev)
+		return -ENODEV;
+
+	return snprintf(buf, 16, "%d\n", udev->ptp ? ptp_clock_index(udev->ptp) : -1);
+}
+
+static DEVICE_ATTR_RO(ptp_index);
+
+/* One "mapN name attributes" line per uio map */
+static ssize_t map_attributes_show(struct device *dev,
+						struct device_attribute *attr, char *buf)
+{
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	int i;
+
+	if (!udev)
+		return -ENODEV;
+
+	for (i = 0; i < udev->nr_maps; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "map%d %s %s\n", i,
+						 udev->info.mem[i].name,
+						 macb_uio_prot_names[udev->maps[i].prot]);
+
+	return len;
+}
+
+static DEVICE_ATTR_RO(map_attributes);
+
+static struct attribute *dev_attrs[] = {
+	&dev_attr_pclk_hz.attr,
+	&dev_attr_phy_mode.attr,
+	&dev_attr_physical_addr.attr,
+	&dev_attr_dma_mask_bits.attr,
+	&dev_attr_dma_coherent.attr,
+	&dev_attr_cache_line_size.attr,
+	&dev_attr_desc_align.attr,
+	&dev_attr_dev_type.attr,
+	&dev_attr_speed_info.attr,
+	&dev_attr_queue_devices.attr,
+	&dev_attr_ring_addr.attr,
+	&dev_attr_ring_size.attr,
+	&dev_attr_pool_addr.attr,
+	&dev_attr_pool_size.attr,
+	&dev_attr_rx_coalesce_usecs.attr,
+	&dev_attr_tx_coalesce_usecs.attr,
+	&dev_attr_housekeeping_cpus.attr,
+	&dev_attr_ptp_index.attr,
+	&dev_attr_map_attributes.attr,
+	NULL,
+};
+
+static const struct attribute_group dev_attr_grp = {
+	.attrs = dev_attrs,
+};
+
+#define MACB_UIO_CAPS_ATTR(_name, _fmt)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct rte_uio_platform_dev *udev = dev_get_drvdata(dev);	\
+									\
+	if (!udev)							\
+		return -ENODEV;						\
+									\
+	return snprintf(buf, 16, _fmt "\n", udev->caps._name);		\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+MACB_UIO_CAPS_ATTR(is_gem, "%d");
+MACB_UIO_CAPS_ATTR(queue_mask, "0x%x");
+MACB_UIO_CAPS_ATTR(num_queues, "%u");
+MACB_UIO_CAPS_ATTR(dbw_bytes, "%u");
+MACB_UIO_CAPS_ATTR(tx_pbuf_size, "%u");
+MACB_UIO_CAPS_ATTR(rx_pbuf_size, "%u");
+MACB_UIO_CAPS_ATTR(jumbo_max_len, "%u");
+MACB_UIO_CAPS_ATTR(t1_screeners, "%u");
+MACB_UIO_CAPS_ATTR(t2_screeners, "%u");
+MACB_UIO_CAPS_ATTR(irq_cor, "%d");
+MACB_UIO_CAPS_ATTR(pcs, "%d");
+MACB_UIO_CAPS_ATTR(lso, "%d");
+MACB_UIO_CAPS_ATTR(rsc, "%d");
+MACB_UIO_CAPS_ATTR(cut_thru, "%d");
+MACB_UIO_CAPS_ATTR(dma64, "%d");
+MACB_UIO_CAPS_ATTR(tsu, "%d");
+MACB_UIO_CAPS_ATTR(high_speed, "%d");
+
+/* caps/: what the silicon was built with, lso covers both TSO and UFO */
+static struct attribute *caps_attrs[] = {
+	&dev_attr_is_gem.attr,
+	&dev_attr_queue_mask.attr,
+	&dev_attr_num_queues.attr,
+	&dev_attr_dbw_bytes.attr,
+	&dev_attr_tx_pbuf_size.attr,
+	&dev_attr_rx_pbuf_size.attr,
+	&dev_attr_jumbo_max_len.attr,
+	&dev_attr_t1_screeners.attr,
+	&dev_attr_t2_screeners.attr,
+	&dev_attr_irq_cor.attr,
+	&dev_attr_pcs.attr,
+	&dev_attr_lso.attr,
+	&dev_attr_rsc.attr,
+	&dev_attr_cut_thru.attr,
+	&dev_attr_dma64.attr,
+	&dev_attr_tsu.attr,
+	&dev_attr_high_speed.attr,
+	NULL,
+};
+
+static const struct attribute_group caps_attr_grp = {
+	.name = "caps",
+	.attrs = caps_attrs,
+};
+
+static const struct attribute_group *dev_attr_grps[] = {
+	&dev_attr_grp,
+	&caps_attr_grp,
+	NULL,
+};
+
+/* Sample the link state from NSR and the speed the MAC is running at */
+static void macb_uio_read_link(struct rte_uio_platform_dev *udev,
+							   struct macb_uio_link *link)
+{
+	u32 ncr, ncfgr;
+
+	/* phylib reports changes through macb_uio_phy_link_change() */
+	if (udev->phydev) {
+		*link = udev->link;
+		return;
+	}
+
+	memset(link, 0, sizeof(*link));
+
+	if (udev->fixed_link) {
+		link->up = true;
+		link->speed = udev->fixed_status.speed;
+		link->duplex = udev->fixed_status.duplex;
+		return;
+	}
+
+	if (!udev->regs)
+		return;
+
+	ncr = macb_uio_readl(udev, MACB_NCR);
+	ncfgr = macb_uio_readl(udev, MACB_NCFGR);
+
+	link->up = !!(macb_uio_readl(udev, MACB_NSR) & MACB_BIT(NSR_LINK));
+	link->duplex = (ncfgr & MACB_BIT(FD)) ? DUPLEX_FULL : DUPLEX_HALF;
+	link->pause = (ncfgr & MACB_BIT(PAE)) ? MACB_UIO_PAUSE_RX : 0;
+
+	if (ncr & GEM_BIT(ENABLE_HS_MAC)) {
+		switch (GEM_BFEXT(HS_MAC_SPEED,
+				  macb_uio_readl(udev, GEM_HS_MAC_CONFIG))) {
+		case HS_SPEED_10000M:
+			link->speed = SPEED_10000;
+			break;
+		case HS_SPEED_5000M:
+			link->speed = SPEED_5000;
+			break;
+		case HS_SPEED_2500M:
+			link->speed = SPEED_2500;
+			break;
+		case HS_SPEED_1000M:
+			link->speed = SPEED_1000;
+			break;
+		default:
+			link->speed = SPEED_100;
+			break;
+		}
+	} else if (ncfgr & GEM_BIT(GBE)) {
+		link->speed = SPEED_1000;
+	} else if (ncfgr & MACB_BIT(SPD)) {
+		link->speed = SPEED_100;
+	} else {
+		link->speed = SPEED_10;
+	}
+}
+
+static bool macb_uio_link_equal(const struct macb_uio_link *a,
+								const struct macb_uio_link *b)
+{
+	return a->up == b->up && a->pause == b->pause &&
+		   a->speed == b->speed && a->duplex == b->duplex;
+}
+
+static void macb_uio_notify_subscribers(struct rte_uio_platform_dev *udev,
+										u32 sw_cause, u32 queue_mask);
+
+static int macb_uio_minor(struct rte_uio_platform_dev *udev)
+{
+	return udev->info.uio_dev ? udev->info.uio_dev->minor : -1;
+}
+
+static void macb_uio_hist_add(atomic64_t *hist, u64 ns)
+{
+	atomic64_inc(&hist[min_t(unsigned int, fls64(ns), MACB_UIO_HIST_BUCKETS - 1)]);
+}
+
+/* Latch a driver generated cause and wake the main device */
+static void macb_uio_raise(struct rte_uio_platform_dev *udev, u32 cause)
+{
+	atomic_or(cause, (atomic_t *)&udev->events->sw_cause);
+	atomic_inc((atomic_t *)&udev->events->event_count);
+	WRITE_ONCE(udev->events->sw_notify_ns, ktime_get_ns());
+	smp_mb__after_atomic();
+	uio_event_notify(&udev->info);
+	atomic64_inc(&udev->dbg.events);
+	trace_macb_uio_notify(macb_uio_minor(udev), -1, cause, 0);
+	macb_uio_notify_subscribers(udev, cause, 0);
+}
+
+/* Copy the link state into the status page under its seqcount */
+static void macb_uio_publish_link(struct rte_uio_platform_dev *udev,
+								  const struct macb_uio_link *link)
+{
+	struct macb_uio_link_status *ls = &udev->status->link;
+	unsigned long flags;
+	bool changed;
+
+	spin_lock_irqsave(&udev->status_lock, flags);
+	changed = !macb_uio_link_equal(link, &udev->link);
+	udev->link = *link;
+
+	WRITE_ONCE(ls->seq, ls->seq + 1);
+	smp_wmb();
+	ls->link_up = link->up;
+	ls->speed = link->up ? link->speed : 0;
+	ls->duplex = link->duplex;
+	ls->pause = link->pause;
+	if (changed)
+		ls->generation++;
+	smp_wmb();
+	WRITE_ONCE(ls->seq, ls->seq + 1);
+	spin_unlock_irqrestore(&udev->status_lock, flags);
+
+	trace_macb_uio_link(macb_uio_minor(udev), link->up, link->speed,
+						link->duplex, link->pause);
+}
+
+/*
+ * Add the clear-on-read statistics registers to the 64-bit counters of
+ * the status page. Only the poll work calls this, so it needs no lock.
+ */
+static void macb_uio_fold_stats(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_stats *stats = &udev->status->stats;
+	u32 val[MACB_UIO_NR_STATS];
+	unsigned int i;
+
+	for (i = 0; i < MACB_UIO_NR_STATS; i++)
+		val[i] = macb_uio_readl(udev, GEM_OTX + i * 4);
+
+	WRITE_ONCE(stats->seq, stats->seq + 1);
+	smp_wmb();
+	for (i = 0; i < MACB_UIO_NR_STATS; i++)
+		stats->counter[i] += val[i];
+	stats->generation++;
+	smp_wmb();
+	WRITE_ONCE(stats->seq, stats->seq + 1);
+}
+
+static u32 macb_uio_tbqp(unsigned int hw_q)
+{
+	return hw_q ? GEM_TBQP(hw_q - 1) : MACB_TBQP;
+}
+
+/*
+ * A transmitter that stays busy (TSR.TGO) while no TX queue pointer
+ * moves for watchdog_ms is reported once as MACB_UIO_EV_TX_HANG. RSR
+ * overrun and used bit read are reported and cleared on every pass
+ * that sees them, the watchdog owns those two bits.
+ */
+static void macb_uio_watchdog(struct rte_uio_platform_dev *udev)
+{
+	u32 tsr, rsr, tbqp, cause = 0;
+	bool moved = false;
+	unsigned int hw_q;
+
+	for (hw_q = 0; hw_q < MACB_UIO_MAX_QUEUES; hw_q++) {
+		if (!(udev->caps.queue_mask & BIT(hw_q)))
+			continue;
+		tbqp = macb_uio_readl(udev, macb_uio_tbqp(hw_q));
+		if (tbqp != udev->wd_tbqp[hw_q])
+			moved = true;
+		udev->wd_tbqp[hw_q] = tbqp;
+	}
+
+	tsr = macb_uio_readl(udev, MACB_TSR);
+	if (moved || !(tsr & MACB_BIT(TGO))) {
+		udev->wd_stalled = false;
+		udev->wd_tx_hung = false;
+	} else if (!udev->wd_stalled) {
+		udev->wd_stalled = true;
+		udev->wd_stall_since = jiffies;
+	} else if (!udev->wd_tx_hung &&
+		   time_after_eq(jiffies, udev->wd_stall_since + msecs_to_jiffies(watchdog_ms))) {
+		udev->wd_tx_hung = true;
+		cause |= MACB_UIO_EV_TX_HANG;
+	}
+
+	rsr = macb_uio_readl(udev, MACB_RSR) & (MACB_BIT(RSR_OVR) | MACB_BIT(BNA));
+	if (rsr) {
+		macb_uio_writel(udev, MACB_RSR, rsr);
+		if (rsr & MACB_BIT(RSR_OVR))
+			cause |= MACB_UIO_EV_RX_OVERRUN;
+		if (rsr & MACB_BIT(BNA))
+			cause |= MACB_UIO_EV_RX_NOBUF;
+	}
+
+	if (cause)
+		macb_uio_raise(udev, cause);
+}
+
+/*
+ * One delayed work per housekeeping CPU polls every open device bound
+ * to that CPU, so the number of wakeups does not grow with the number
+ * of ports. Devices due within MACB_UIO_POLL_SLACK of each other are
+ * serviced in the same pass.
+ */
+struct macb_uio_poll_engine {
+	struct list_head devices;
+	struct delayed_work work;
+	int cpu;
+	bool ready;
+};
+
+static DEFINE_PER_CPU(struct macb_uio_poll_engine, macb_uio_engines);
+
+/*
+ * Poll the link and notify userspace only when it changed. The
+ * interval starts at link_poll_min_ms after open or a transition and
+ * doubles on every quiet pass up to link_poll_max_ms. With force_poll
+ * set, userspace is notified every UIO_POLL_INTERVAL as before.
+ */
+static void macb_uio_poll(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_link link;
+
+	macb_uio_read_link(udev, &link);
+	if (!macb_uio_link_equal(&link, &udev->link)) {
+		macb_uio_publish_link(udev, &link);
+		macb_uio_raise(udev, MACB_UIO_EV_LINK);
+		udev->poll_interval = force_poll ? UIO_POLL_INTERVAL : link_poll_min_ms;
+	} else if (force_poll) {
+		uio_event_notify(&udev->info);
+		udev->poll_interval = UIO_POLL_INTERVAL;
+	} else {
+		/* link_poll_min_ms may be 0, which would never back off */
+		udev->poll_interval = min(max(udev->poll_interval, 1U) * 2, link_poll_max_ms);
+	}
+
+	/* Frame counters wrap in under 5 minutes at 10G line rate */
+	if (stats_accumulate && udev->caps.is_gem) {
+		macb_uio_fold_stats(udev);
+		udev->poll_interval = min_t(unsigned int, udev->poll_interval, MACB_UIO_STATS_INTERVAL);
+	}
+
+	/* Sample at least twice per timeout */
+	if (watchdog_ms && udev->regs) {
+		macb_uio_watchdog(udev);
+		udev->poll_interval = min(udev->poll_interval, max(watchdog_ms / 2, 1U));
+	}
+}
+
+static void macb_uio_poll_work_fn(struct work_struct *work)
+{
+	struct macb_uio_poll_engine *engine =
+		container_of(to_delayed_work(work), struct macb_uio_poll_engine, work);
+	unsigned long slack = msecs_to_jiffies(MACB_UIO_POLL_SLACK);
+	struct rte_uio_platform_dev *udev;
+	unsigned long now, next = 0;
+	bool armed = false;
+
+	mutex_lock(&macb_uio_poll_lock);
+	now = jiffies;
+	list_for_each_entry(udev, &engine->devices, poll_node) {
+		if (time_before_eq(udev->poll_next, now + slack)) {
+			macb_uio_poll(udev);
+			udev->poll_next = now +
+				msecs_to_jiffies(max(udev->poll_interval, 1U));
+		}
+		if (!armed || time_before(udev->poll_next, next))
+			next = udev->poll_next;
+		armed = true;
+	}
+	if (armed)
+		mod_delayed_work_on(engine->cpu, system_wq, &engine->work,
+				    time_after(next, now) ? next - now : 0);
+	mutex_unlock(&macb_uio_poll_lock);
+}
+
+/*
+ * First online CPU of the device mask other than skip, any other online
+ * CPU if there is none. skip is nr_cpu_ids unless skip is going down.
+ */
+static int macb_uio_housekeeping_cpu(struct rte_uio_platform_dev *udev,
+									 unsigned int skip)
+{
+	unsigned int cpu;
+
+	for_each_cpu_and(cpu, udev->hk_mask, cpu_online_mask) {
+		if (cpu != skip)
+			return cpu;
+	}
+
+	if (skip >= nr_cpu_ids)
+		return cpumask_first(cpu_online_mask);
+
+	return cpumask_any_but(cpu_online_mask, skip);
+}
+
+/* Queue udev on the engine of cpu, called with macb_uio_poll_lock held */
+static void macb_uio_poll_attach(struct rte_uio_platform_dev *udev, int cpu)
+{
+	struct macb_uio_poll_engine *engine = per_cpu_ptr(&macb_uio_engines, cpu);
+
+	if (!engine->ready) {
+		INIT_LIST_HEAD(&engine->devices);
+		INIT_DELAYED_WORK(&engine->work, macb_uio_poll_work_fn);
+		engine->cpu = cpu;
+		engine->ready = true;
+	}
+	udev->engine = engine;
+	list_add_tail(&udev->poll_node, &engine->devices);
+	mod_delayed_work_on(cpu, system_wq, &engine->work, 0);
+}
+
+static void macb_uio_poll_add(struct rte_uio_platform_dev *udev)
+{
+	cpus_read_lock();
+	mutex_lock(&macb_uio_poll_lock);
+	udev->poll_interval = link_poll_min_ms;
+	udev->poll_next = jiffies;
+	macb_uio_poll_attach(udev, macb_uio_housekeeping_cpu(udev, nr_cpu_ids));
+	mutex_unlock(&macb_uio_poll_lock);
+	cpus_read_unlock();
+}
+
+/*
+ * A delayed work queued on an offline CPU never runs, so the devices
+ * of a CPU going down move to another housekeeping CPU, keeping their
+ * poll schedule.
+ */
+static int macb_uio_cpu_offline(unsigned int cpu)
+{
+	struct macb_uio_poll_engine *engine = per_cpu_ptr(&macb_uio_engines, cpu);
+	struct rte_uio_platform_dev *udev, *tmp;
+	LIST_HEAD(devices);
+
+	mutex_lock(&macb_uio_poll_lock);
+	if (engine->ready)
+		list_splice_init(&engine->devices, &devices);
+	mutex_unlock(&macb_uio_poll_lock);
+
+	if (list_empty(&devices))
+		return 0;
+
+	/* The work finds the list empty and does not re-arm */
+	cancel_delayed_work_sync(&engine->work);
+
+	mutex_lock(&macb_uio_poll_lock);
+	list_for_each_entry_safe(udev, tmp, &devices, poll_node) {
+		list_del(&udev->poll_node);
+		macb_uio_poll_attach(udev, macb_uio_housekeeping_cpu(udev, cpu));
+	}
+	mutex_unlock(&macb_uio_poll_lock);
+
+	return 0;
+}
+
+static void macb_uio_poll_del(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_poll_engine *engine;
+	bool idle;
+
+	/* udev->engine changes when its CPU goes offline */
+	mutex_lock(&macb_uio_poll_lock);
+	engine = udev->engine;
+	list_del_init(&udev->poll_node);
+	udev->engine = NULL;
+	idle = list_empty(&engine->devices);
+	mutex_unlock(&macb_uio_poll_lock);
+
+	if (!idle)
+		return;
+
+	/* Do not leave the work pending behind the last device */
+	cancel_delayed_work_sync(&engine->work);
+	mutex_lock(&macb_uio_poll_lock);
+	if (!list_empty(&engine->devices))
+		mod_delayed_work_on(engine->cpu, system_wq, &engine->work, 0);
+	mutex_unlock(&macb_uio_poll_lock);
+}
+
+static LIST_HEAD(macb_uio_phy_list);
+static DEFINE_SPINLOCK(macb_uio_phy_lock);
+
+static int macb_uio_mdio_wait_for_idle(struct rte_uio_platform_dev *udev)
+{
+	u32 val;
+
+	return readl_poll_timeout(udev->regs + MACB_NSR, val,
+				  val & MACB_BIT(IDLE), 1, MACB_MDIO_TIMEOUT);
+}
+
+/* Run one management frame, returns the data read or a negative errno */
+static int macb_uio_mdio_xfer(struct rte_uio_platform_dev *udev, u32 frame)
+{
+	int err;
+
+	err = macb_uio_mdio_wait_for_idle(udev);
+	if (err)
+		return err;
+
+	macb_uio_writel(udev, MACB_MAN, frame);
+
+	err = macb_uio_mdio_wait_for_idle(udev);
+	if (err)
+		return err;
+
+	return MACB_BFEXT(DATA, macb_uio_readl(udev, MACB_MAN));
+}
+
+static int macb_uio_mdio_read_c22(struct mii_bus *bus, int mii_id, int regnum)
+{
+	return macb_uio_mdio_xfer(bus->priv,
+				  MACB_BF(SOF, MACB_MAN_C22_SOF) |
+				  MACB_BF(RW, MACB_MAN_C22_READ) |
+				  MACB_BF(PHYA, mii_id) |
+				  MACB_BF(REGA, regnum) |
+				  MACB_BF(CODE, MACB_MAN_C22_CODE));
+}
+
+static int macb_uio_mdio_write_c22(struct mii_bus *bus, int mii_id, int regnum,
+								   u16 value)
+{
+	int err;
+
+	err = macb_uio_mdio_xfer(bus->priv,
+				 MACB_BF(SOF, MACB_MAN_C22_SOF) |
+				 MACB_BF(RW, MACB_MAN_C22_WRITE) |
+				 MACB_BF(PHYA, mii_id) |
+				 MACB_BF(REGA, regnum) |
+				 MACB_BF(CODE, MACB_MAN_C22_CODE) |
+				 MACB_BF(DATA, value));
+
+	return err < 0 ? err : 0;
+}
+
+static int macb_uio_mdio_c45_addr(struct mii_bus *bus, int mii_id, int devad,
+								  int regnum)
+{
+	return macb_uio_mdio_xfer(bus->priv,
+				  MACB_BF(SOF, MACB_MAN_C45_SOF) |
+				  MACB_BF(RW, MACB_MAN_C45_ADDR) |
+				  MACB_BF(PHYA, mii_id) |
+				  MACB_BF(REGA, devad) |
+				  MACB_BF(CODE, MACB_MAN_C45_CODE) |
+				  MACB_BF(DATA, regnum));
+}
+
+static int macb_uio_mdio_read_c45(struct mii_bus *bus, int mii_id, int devad,
+								  int regnum)
+{
+	int err;
+
+	err = macb_uio_mdio_c45_addr(bus, mii_id, devad, regnum);
+	if (err < 0)
+		return err;
+
+	return macb_uio_mdio_xfer(bus->priv,
+				  MACB_BF(SOF, MACB_MAN_C45_SOF) |
+				  MACB_BF(RW, MACB_MAN_C45_READ) |
+				  MACB_BF(PHYA, mii_id) |
+				  MACB_BF(REGA, devad) |
+				  MACB_BF(CODE, MACB_MAN_C45_CODE));
+}
+
+static int macb_uio_mdio_write_c45(struct mii_bus *bus, int mii_id, int devad,
+								   int regnum, u16 value)
+{
+	int err;
+
+	err = macb_uio_mdio_c45_addr(bus, mii_id, devad, regnum);
+	if (err < 0)
+		return err;
+
+	err = macb_uio_mdio_xfer(bus->priv,
+				 MACB_BF(SOF, MACB_MAN_C45_SOF) |
+				 MACB_BF(RW, MACB_MAN_C45_WRITE) |
+				 MACB_BF(PHYA, mii_id) |
+				 MACB_BF(REGA, devad) |
+				 MACB_BF(CODE, MACB_MAN_C45_CODE) |
+				 MACB_BF(DATA, value));
+
+	return err < 0 ? err : 0;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+static int macb_uio_mdio_read(struct mii_bus *bus, int mii_id, int regnum)
+{
+	if (regnum & MII_ADDR_C45)
+		return macb_uio_mdio_read_c45(bus, mii_id, (regnum >> 16) & 0x1f,
+					      regnum & 0xffff);
+
+	return macb_uio_mdio_read_c22(bus, mii_id, regnum);
+}
+
+static int macb_uio_mdio_write(struct mii_bus *bus, int mii_id, int regnum,
+							   u16 value)
+{
+	if (regnum & MII_ADDR_C45)
+		return macb_uio_mdio_write_c45(bus, mii_id, (regnum >> 16) & 0x1f,
+					       regnum & 0xffff, value);
+
+	return macb_uio_mdio_write_c22(bus, mii_id, regnum, value);
+}
+#endif
+
+static u32 macb_uio_mdc_clk_div(unsigned long pclk_hz)
+{
+	if (pclk_hz <= 20000000)
+		return GEM_CLK_DIV8;
+	else if (pclk_hz <= 40000000)
+		return GEM_CLK_DIV16;
+	else if (pclk_hz <= 80000000)
+		return GEM_CLK_DIV32;
+	else if (pclk_hz <= 120000000)
+		return GEM_CLK_DIV48;
+	else if (pclk_hz <= 160000000)
+		return GEM_CLK_DIV64;
+	else if (pclk_hz <= 240000000)
+		return GEM_CLK_DIV96;
+	else if (pclk_hz <= 320000000)
+		return GEM_CLK_DIV128;
+
+	return GEM_CLK_DIV224;
+}
+
+/* Reprogram the MAC and the high speed PCS for the speed phylib resolved */
+static void macb_uio_mac_link_up(struct rte_uio_platform_dev *udev,
+								 const struct macb_uio_link *link)
+{
+	u32 ncr, ncfgr, hs_speed;
+
+	ncr = macb_uio_readl(udev, MACB_NCR) & ~GEM_BIT(ENABLE_HS_MAC);
+	ncfgr = macb_uio_readl(udev, MACB_NCFGR);
+	ncfgr &= ~(MACB_BIT(SPD) | MACB_BIT(FD) | GEM_BIT(GBE) | MACB_BIT(PAE));
+
+	if (link->duplex == DUPLEX_FULL)
+		ncfgr |= MACB_BIT(FD);
+	if (link->pause & MACB_UIO_PAUSE_RX)
+		ncfgr |= MACB_BIT(PAE);
+
+	switch (link->speed) {
+	case SPEED_10000:
+		hs_speed = HS_SPEED_10000M;
+		break;
+	case SPEED_5000:
+		hs_speed = HS_SPEED_5000M;
+		break;
+	case SPEED_2500:
+		hs_speed = HS_SPEED_2500M;
+		break;
+	case SPEED_1000:
+		ncfgr |= GEM_BIT(GBE);
+		hs_speed = HS_SPEED_1000M;
+		break;
+	case SPEED_100:
+		ncfgr |= MACB_BIT(SPD);
+		hs_speed = HS_SPEED_100M;
+		break;
+	default:
+		hs_speed = HS_SPEED_100M;
+		break;
+	}
+
+	if (udev->phydev->interface == PHY_INTERFACE_MODE_USXGMII ||
+	    link->speed > SPEED_1000) {
+		ncr |= GEM_BIT(ENABLE_HS_MAC);
+		macb_uio_writel(udev, GEM_HS_MAC_CONFIG,
+				GEM_BFINS(HS_MAC_SPEED, hs_speed,
+					  macb_uio_readl(udev, GEM_HS_MAC_CONFIG)));
+		if (udev->phydev->interface == PHY_INTERFACE_MODE_USXGMII)
+			macb_uio_writel(udev, GEM_USX_CONTROL,
+					GEM_BFINS(USX_CTRL_SPEED, hs_speed,
+						  macb_uio_readl(udev, GEM_USX_CONTROL)));
+	}
+
+	macb_uio_writel(udev, MACB_NCFGR, ncfgr);
+	macb_uio_writel(udev, MACB_NCR, ncr);
+}
+
+/*
+ * phylib calls this from its state machine in place of the netdev
+ * carrier handling, there is no net_device behind a uio port.
+ */
+static void macb_uio_phy_link_change(struct phy_device *phydev, bool up)
+{
+	struct rte_uio_platform_dev *udev = NULL, *tmp;
+	struct macb_uio_link link = {};
+
+	spin_lock(&macb_uio_phy_lock);
+	list_for_each_entry(tmp, &macb_uio_phy_list, phy_node) {
+		if (tmp->phydev == phydev) {
+			udev = tmp;
+			break;
+		}
+	}
+	spin_unlock(&macb_uio_phy_lock);
+
+	if (!udev)
+		return;
+
+	link.up = up;
+	if (up) {
+		link.speed = phydev->speed;
+		link.duplex = phydev->duplex;
+		if (phydev->pause)
+			link.pause = MACB_UIO_PAUSE_RX | MACB_UIO_PAUSE_TX;
+		else if (phydev->asym_pause)
+			link.pause = MACB_UIO_PAUSE_TX;
+		macb_uio_mac_link_up(udev, &link);
+	}
+
+	macb_uio_publish_link(udev, &link);
+	if (atomic_read(&udev->refcnt) > 0)
+		macb_uio_raise(udev, MACB_UIO_EV_LINK);
+}
+
+static int macb_uio_mii_register(struct rte_uio_platform_dev *udev)
+{
+	struct device_node *np = udev->pdev->dev.of_node;
+	struct device_node *child;
+	int err;
+
+	if (!np)
+		return mdiobus_register(udev->mii_bus);
+
+	child = of_get_child_by_name(np, "mdio");
+	err = of_mdiobus_register(udev->mii_bus, child ? child : np);
+	of_node_put(child);
+
+	return err;
+}
+
+static struct phy_device *macb_uio_find_phy(struct rte_uio_platform_dev *udev)
+{
+	struct device_node *np = udev->pdev->dev.of_node;
+	struct device_node *phy_node;
+	struct phy_device *phydev;
+
+	phy_node = np ? of_parse_phandle(np, "phy-handle", 0) : NULL;
+	if (phy_node) {
+		/* of_phy_find_device() takes a reference */
+		phydev = of_phy_find_device(phy_node);
+		of_node_put(phy_node);
+		return phydev;
+	}
+
+	phydev = phy_find_first(udev->mii_bus);
+	if (phydev)
+		get_device(&phydev->mdio.dev);
+
+	return phydev;
+}
+
+/* Register the GEM MDIO bus and attach the PHY described by firmware */
+static int macb_uio_setup_phy(struct rte_uio_platform_dev *udev)
+{
+	struct device *dev = &udev->pdev->dev;
+	struct phy_device *phydev;
+	int interface, err;
+	u32 ncfgr;
+
+	if (!phy_manage || udev->fixed_link || !udev->regs)
+		return 0;
+
+	interface = fwnode_get_phy_mode(dev_fwnode(dev));
+	if (interface < 0)
+		interface = PHY_INTERFACE_MODE_SGMII;
+
+	ncfgr = macb_uio_readl(udev, MACB_NCFGR);
+	ncfgr = GEM_BFINS(CLK, macb_uio_mdc_clk_div(udev->pclk_hz), ncfgr);
+	macb_uio_writel(udev, MACB_NCFGR, ncfgr);
+	macb_uio_writel(udev, MACB_NCR,
+			macb_uio_readl(udev, MACB_NCR) | MACB_BIT(MPE));
+
+	udev->mii_bus = mdiobus_alloc();
+	if (!udev->mii_bus)
+		return -ENOMEM;
+
+	udev->mii_bus->name = DRIVER_NAME " MII bus";
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+	udev->mii_bus->read = macb_uio_mdio_read;
+	udev->mii_bus->write = macb_uio_mdio_write;
+#else
+	udev->mii_bus->read = macb_uio_mdio_read_c22;
+	udev->mii_bus->write = macb_uio_mdio_write_c22;
+	udev->mii_bus->read_c45 = macb_uio_mdio_read_c45;
+	udev->mii_bus->write_c45 = macb_uio_mdio_write_c45;
+#endif
+	snprintf(udev->mii_bus->id, MII_BUS_ID_SIZE, "%s-mii", dev_name(dev));
+	udev->mii_bus->priv = udev;
+	udev->mii_bus->parent = dev;
+
+	err = macb_uio_mii_register(udev);
+	if (err)
+		goto fail_free_bus;
+
+	phydev = macb_uio_find_phy(udev);
+	if (!phydev) {
+		dev_err(dev, "no PHY found\n");
+		err = -ENODEV;
+		goto fail_unregister_bus;
+	}
+
+	err = phy_attach_direct(NULL, phydev, 0, interface);
+	put_device(&phydev->mdio.dev);
+	if (err) {
+		dev_err(dev, "Could not attach PHY (%d)\n", err);
+		goto fail_unregister_bus;
+	}
+
+	/*
+	 * With no net_device, phy_attach_direct() pins the module owning
+	 * the bus, which is this one for the GEM MDIO bus, and rmmod would
+	 * fail until every port is unbound. Drop that self-reference, remove
+	 * detaches the PHY before the module can go. release_phy() takes it
+	 * back for phy_detach() to put.
+	 */
+	if (phydev->mdio.bus->owner == THIS_MODULE)
+		module_put(THIS_MODULE);
+
+	phydev->phy_link_change = macb_uio_phy_link_change;
+	phy_support_asym_pause(phydev);
+
+	udev->phydev = phydev;
+	spin_lock(&macb_uio_phy_lock);
+	list_add(&udev->phy_node, &macb_uio_phy_list);
+	spin_unlock(&macb_uio_phy_lock);
+
+	phy_attached_info(phydev);
+
+	return 0;
+
+fail_unregister_bus:
+	mdiobus_unregister(udev->mii_bus);
+fail_free_bus:
+	mdiobus_free(udev->mii_bus);
+	udev->mii_bus = NULL;
+
+	return err;
+}
+
+static void macb_uio_phy_start(struct rte_uio_platform_dev *udev)
+{
+	if (udev->phydev && !udev->phy_started) {
+		phy_start(udev->phydev);
+		udev->phy_started = true;
+	}
+}
+
+static void macb_uio_phy_stop(struct rte_uio_platform_dev *udev)
+{
+	if (udev->phydev && udev->phy_started) {
+		phy_stop(udev->phydev);
+		udev->phy_started = false;
+	}
+}
+
+static void macb_uio_release_phy(struct rte_uio_platform_dev *udev)
+{
+	if (udev->phydev) {
+		macb_uio_phy_stop(udev);
+		spin_lock(&macb_uio_phy_lock);
+		list_del(&udev->phy_node);
+		spin_unlock(&macb_uio_phy_lock);
+		if (udev->phydev->mdio.bus->owner == THIS_MODULE)
+			__module_get(THIS_MODULE);
+		phy_detach(udev->phydev);
+		udev->phydev = NULL;
+	}
+
+	if (udev->mii_bus) {
+		mdiobus_unregister(udev->mii_bus);
+		mdiobus_free(udev->mii_bus);
+		udev->mii_bus = NULL;
+	}
+}
+
+/*
+ * Top half: mask the sources that fired so a level interrupt stops
+ * asserting, ack them and hand the event to userspace. Userspace
+ * re-enables the sources once it has serviced them.
+ */
+static irqreturn_t macb_uio_interrupt(int irq, void *dev_id)
+{
+	struct macb_uio_queue *queue = dev_id;
+	struct rte_uio_platform_dev *udev = queue->udev;
+	struct macb_uio_queue_events *qev;
+	u64 entry_ns = ktime_get_ns();
+	u64 notify_ns;
+	u32 status;
+
+	spin_lock(&udev->irq_lock);
+	status = macb_uio_readl(udev, queue->isr);
+	status &= ~macb_uio_readl(udev, queue->imr);
+	if (!status) {
+		spin_unlock(&udev->irq_lock);
+		atomic64_inc(&udev->dbg.spurious);
+		return IRQ_NONE;
+	}
+
+	macb_uio_writel(udev, queue->idr, status);
+	if (!udev->caps.irq_cor)
+		macb_uio_writel(udev, queue->isr, status);
+	spin_unlock(&udev->irq_lock);
+
+	/* Publish the causes before the wakeup that makes userspace look */
+	trace_macb_uio_irq(macb_uio_minor(udev), queue->index, status);
+	qev = &udev->events->queue[queue->index];
+	if (atomic_fetch_or(status, (atomic_t *)&qev->isr))
+		atomic64_inc(&udev->dbg.coalesced);
+	atomic_inc((atomic_t *)&qev->events);
+	if (!queue->has_uio)
+		atomic_inc((atomic_t *)&udev->events->event_count);
+	notify_ns = ktime_get_ns();
+	WRITE_ONCE(qev->notify_ns, notify_ns);
+	smp_mb__after_atomic();
+
+	uio_event_notify(queue->has_uio ? &queue->info : &udev->info);
+	WRITE_ONCE(queue->notify_ns, notify_ns);
+	atomic64_inc(&udev->dbg.events);
+	macb_uio_hist_add(udev->dbg.irq_to_notify, notify_ns - entry_ns);
+	trace_macb_uio_notify(macb_uio_minor(udev), queue->index, status,
+						  notify_ns - entry_ns);
+	macb_uio_notify_subscribers(udev, 0, BIT(queue->index));
+
+	return IRQ_HANDLED;
+}
+
+static void macb_uio_queue_arm(struct macb_uio_queue *queue, s32 irq_on)
+{
+	struct rte_uio_platform_dev *udev = queue->udev;
+	u64 notify_ns = xchg(&queue->notify_ns, 0);
+
+	/* The re-arm is the first sign that userspace handled the event */
+	if (irq_on && notify_ns)
+		macb_uio_hist_add(udev->dbg.notify_to_arm, ktime_get_ns() - notify_ns);
+	trace_macb_uio_irqcontrol(macb_uio_minor(udev), queue->index, irq_on);
+
+	if (irq_on)
+		macb_uio_writel(udev, queue->ier, irq_sources);
+	else
+		macb_uio_writel(udev, queue->idr, irq_sources);
+}
+
+/*
+ * Writing 1 to /dev/uioX arms irq_sources on every queue that has no
+ * uio device of its own, writing 0 masks them again. Status latched
+ * while the sources were masked is left pending, so an event that
+ * raced with the re-arm raises the interrupt as soon as IER is written
+ * instead of being lost.
+ */
+static int macb_uio_irqcontrol(struct uio_info *info, s32 irq_on)
+{
+	struct rte_uio_platform_dev *udev = info->priv;
+	unsigned long flags;
+	unsigned int i;
+
+	if (!udev->nr_irqs)
+		return -EIO;
+
+	spin_lock_irqsave(&udev->irq_lock, flags);
+	for (i = 0; i < udev->nr_irqs; i++) {
+		if (!udev->queues[i].has_uio)
+			macb_uio_queue_arm(&udev->queues[i], irq_on);
+	}
+	spin_unlock_irqrestore(&udev->irq_lock, flags);
+
+	return 0;
+}
+
+/* irqcontrol of the per-queue uio devices, only touches that queue */
+static int macb_uio_queue_irqcontrol(struct uio_info *info, s32 irq_on)
+{
+	struct macb_uio_queue *queue = info->priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->udev->irq_lock, flags);
+	macb_uio_queue_arm(queue, irq_on);
+	spin_unlock_irqrestore(&queue->udev->irq_lock, flags);
+
+	return 0;
+}
+
+static int macb_uio_open(struct uio_info *info, struct inode *inode)
+{
+	struct rte_uio_platform_dev *udev = info->priv;
+	struct macb_uio_link link;
+
+	if (atomic_inc_return(&udev->refcnt) != 1)
+		return 0;
+
+	/* The PMD may have reset the MAC since the timers were set */
+	macb_uio_set_coalesce(udev);
+	udev->wd_stalled = false;
+	udev->wd_tx_hung = false;
+
+	/* The opener reads the link itself, only report changes from here */
+	macb_uio_read_link(udev, &link);
+	macb_uio_publish_link(udev, &link);
+	macb_uio_phy_start(udev);
+
+	if (list_empty(&udev->poll_node))
+		macb_uio_poll_add(udev);
+
+	return 0;
+}
+
+/* Clear RE/TE so the MAC stops walking rings and writing buffers */
+static void macb_uio_stop_dma(struct rte_uio_platform_dev *udev)
+{
+	u32 ncr;
+
+	if (!udev->regs)
+		return;
+
+	ncr = macb_uio_readl(udev, MACB_NCR);
+	macb_uio_writel(udev, MACB_NCR, ncr & ~(MACB_BIT(RE) | MACB_BIT(TE)));
+}
+
+/*
+ * Without persist the state the last opener left behind is gone: stop
+ * the DMA before clearing the rings it walks, mask every source, drop
+ * latched causes and the PMD scratch area and bump state_generation
+ * so the next opener knows it has to start from scratch.
+ */
+static void macb_uio_reset_state(struct rte_uio_platform_dev *udev)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	if (udev->regs) {
+		macb_uio_stop_dma(udev);
+
+		spin_lock_irqsave(&udev->irq_lock, flags);
+		for (i = 0; i < udev->nr_irqs; i++)
+			macb_uio_writel(udev, udev->queues[i].idr, ~0U);
+		spin_unlock_irqrestore(&udev->irq_lock, flags);
+	}
+
+	if (udev->rings.cpu_addr)
+		memset(udev->rings.cpu_addr, 0, udev->rings.size);
+
+	for (i = 0; i < MACB_UIO_MAX_QUEUES; i++)
+		WRITE_ONCE(udev->events->queue[i].isr, 0);
+	WRITE_ONCE(udev->events->sw_cause, 0);
+	memset(udev->events->pmd_state, 0, sizeof(udev->events->pmd_state));
+
+	smp_wmb();
+	WRITE_ONCE(udev->status->state_generation, udev->status->state_generation + 1);
+}
+
+static int macb_uio_release(struct uio_info *info, struct inode *inode)
+{
+	struct rte_uio_platform_dev *udev = info->priv;
+
+	if (!atomic_dec_and_test(&udev->refcnt))
+		return 0;
+
+	/* The driver keeps everything for the next opener */
+	if (persist)
+		return 0;
+
+	if (!list_empty(&udev->poll_node))
+		macb_uio_poll_del(udev);
+	if (!phy_early_start)
+		macb_uio_phy_stop(udev);
+	macb_uio_reset_state(udev);
+
+	return 0;
+}
+
+static void macb_uio_irq_hint(unsigned int irq, const struct cpumask *mask)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+	irq_set_affinity_and_hint(irq, mask);
+#else
+	irq_set_affinity_hint(irq, mask);
+#endif
+}
+
+/* Steer every IRQ of the device to its housekeeping CPUs */
+static void macb_uio_set_irq_affinity(struct rte_uio_platform_dev *udev)
+{
+	unsigned int i;
+
+	for (i = 0; i < udev->nr_irqs; i++)
+		macb_uio_irq_hint(udev->queues[i].irq, udev->hk_mask);
+}
+
+/* Default to the CPUs of the device node unless housekeeping_cpus is set */
+static int macb_uio_setup_hk_mask(struct rte_uio_platform_dev *udev)
+{
+	int node = dev_to_node(&udev->pdev->dev);
+
+	if (!zalloc_cpumask_var(&udev->hk_mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	if (housekeeping_cpus && !cpulist_parse(housekeeping_cpus, udev->hk_mask) &&
+	    cpumask_intersects(udev->hk_mask, cpu_online_mask))
+		return 0;
+
+	if (housekeeping_cpus)
+		dev_warn(&udev->pdev->dev, "Ignoring invalid housekeeping_cpus \"%s\".\n",
+				 housekeeping_cpus);
+
+	if (node != NUMA_NO_NODE && cpumask_intersects(cpumask_of_node(node), cpu_online_mask))
+		cpumask_copy(udev->hk_mask, cpumask_of_node(node));
+	else
+		cpumask_copy(udev->hk_mask, cpu_online_mask);
+
+	return 0;
+}
+
+static void macb_uio_free_irqs(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_queue *queue;
+	unsigned int i;
+
+	for (i = 0; i < udev->nr_irqs; i++) {
+		queue = &udev->queues[i];
+		macb_uio_writel(udev, queue->idr, ~0U);
+		macb_uio_irq_hint(queue->irq, NULL);
+		free_irq(queue->irq, queue);
+		if (queue->has_uio)
+			uio_unregister_device(&queue->info);
+		queue->has_uio = false;
+	}
+
+	udev->nr_irqs = 0;
+}
+
+/*
+ * Decode the design config registers. Queue 0 always exists, DCFG6
+ * flags the additional priority queues. Packet buffer sizes are given
+ * as address widths in data bus words.
+ */
+static void macb_uio_read_caps(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_caps *caps = &udev->caps;
+	u32 dcfg1, dcfg2, dcfg6, dcfg8;
+
+	caps->queue_mask = 0x1;
+	caps->num_queues = 1;
+	if (!udev->regs)
+		return;
+
+	caps->is_gem = MACB_BFEXT(IDNUM, macb_uio_readl(udev, MACB_MID)) >= 0x2;
+	if (!caps->is_gem)
+		return;
+
+	dcfg1 = macb_uio_readl(udev, GEM_DCFG1);
+	dcfg2 = macb_uio_readl(udev, GEM_DCFG2);
+	dcfg6 = macb_uio_readl(udev, GEM_DCFG6);
+	dcfg8 = macb_uio_readl(udev, GEM_DCFG8);
+
+	caps->queue_mask |= dcfg6 & 0xff;
+	caps->num_queues = hweight32(caps->queue_mask);
+
+	switch (GEM_BFEXT(DBWDEF, dcfg1)) {
+	case 4:
+		caps->dbw_bytes = 16;
+		break;
+	case 2:
+		caps->dbw_bytes = 8;
+		break;
+	default:
+		caps->dbw_bytes = 4;
+		break;
+	}
+
+	if (dcfg2 & GEM_BIT(TX_PKT_BUFF))
+		caps->tx_pbuf_size = caps->dbw_bytes << GEM_BFEXT(TX_PBUF_ADDR, dcfg2);
+	if (dcfg2 & GEM_BIT(RX_PKT_BUFF))
+		caps->rx_pbuf_size = caps->dbw_bytes << GEM_BFEXT(RX_PBUF_ADDR, dcfg2);
+
+	caps->jumbo_max_len = GEM_BFEXT(JML_SIZE, macb_uio_readl(udev, GEM_JML));
+	caps->t1_screeners = GEM_BFEXT(T1SCR, dcfg8);
+	caps->t2_screeners = GEM_BFEXT(T2SCR, dcfg8);
+	caps->irq_cor = !!(dcfg1 & GEM_BIT(IRQCOR));
+	caps->pcs = !(dcfg1 & GEM_BIT(NO_PCS));
+	caps->lso = !!(dcfg6 & GEM_BIT(PBUF_LSO));
+	caps->rsc = !!(dcfg6 & GEM_BIT(PBUF_RSC));
+	caps->cut_thru = !!(dcfg6 & GEM_BIT(PBUF_CUTTHRU));
+	caps->dma64 = !!(dcfg6 & GEM_BIT(DAW64));
+	caps->tsu = !!(macb_uio_readl(udev, GEM_DCFG5) & GEM_BIT(TSU));
+	caps->high_speed = !!(macb_uio_readl(udev, GEM_DCFG12) & GEM_BIT(HIGH_SPEED));
+}
+
+/*
+ * GEMs built with 64-bit addressing take the same 44-bit mask as the
+ * kernel macb driver, the others can only reach the low 4 GiB.
+ */
+static void macb_uio_set_dma_mask(struct rte_uio_platform_dev *udev)
+{
+	struct device *dev = &udev->pdev->dev;
+
+	udev->dma_mask_bits = udev->caps.dma64 ? 44 : 32;
+
+	if (dma_set_mask_and_coherent(dev, DMA_BIT_MASK(udev->dma_mask_bits))) {
+		dev_warn(dev, "Failed to set %u-bit DMA mask, using 32-bit.\n",
+				 udev->dma_mask_bits);
+		udev->dma_mask_bits = 32;
+		dma_set_mask_and_coherent(dev, DMA_BIT_MASK(32));
+	}
+}
+
+/*
+ * On a coherent GEM (DT dma-coherent, ACPI _CCA) the PMD can skip cache
+ * maintenance and use lighter barriers. Otherwise descriptors the CPU
+ * maintains by hand must not share a cache line with their neighbours,
+ * so the recommended alignment grows to the DMA cache alignment.
+ */
+static void macb_uio_read_dma_attrs(struct rte_uio_platform_dev *udev)
+{
+	struct device *dev = &udev->pdev->dev;
+	unsigned int desc_bytes = udev->caps.dma64 ? 16 : 8;
+
+	udev->dma_coherent = dev_is_dma_coherent(dev);
+	udev->cache_line_size = cache_line_size();
+	udev->desc_align = desc_bytes;
+	if (!udev->dma_coherent)
+		udev->desc_align = max_t(unsigned int, desc_bytes,
+								 dma_get_cache_alignment());
+}
+
+/*
+ * PTP clock on the GEM timestamp unit, so linuxptp can discipline it
+ * while the PMD only reads the timestamps in the descriptors.
+ */
+static void macb_uio_tsu_get(struct rte_uio_platform_dev *udev,
+							 struct timespec64 *ts)
+{
+	u32 first, second, secl, sech;
+
+	first = macb_uio_readl(udev, GEM_TN);
+	secl = macb_uio_readl(udev, GEM_TSL);
+	sech = macb_uio_readl(udev, GEM_TSH);
+	second = macb_uio_readl(udev, GEM_TN);
+
+	/* The seconds may belong to either side of a nanosecond rollover */
+	if (first > second) {
+		ts->tv_nsec = macb_uio_readl(udev, GEM_TN);
+		secl = macb_uio_readl(udev, GEM_TSL);
+		sech = macb_uio_readl(udev, GEM_TSH);
+	} else {
+		ts->tv_nsec = first;
+	}
+
+	ts->tv_sec = (((u64)sech << GEM_TSL_SIZE) | secl) & MACB_TSU_SEC_MAX;
+}
+
+static void macb_uio_tsu_set(struct rte_uio_platform_dev *udev,
+							 const struct timespec64 *ts)
+{
+	/* Keep TN from carrying into the seconds while they are written */
+	macb_uio_writel(udev, GEM_TN, 0);
+	macb_uio_writel(udev, GEM_TSH, upper_32_bits(ts->tv_sec) & GENMASK(GEM_TSH_SIZE - 1, 0));
+	macb_uio_writel(udev, GEM_TSL, lower_32_bits(ts->tv_sec));
+	macb_uio_writel(udev, GEM_TN, ts->tv_nsec);
+}
+
+static void macb_uio_tsu_set_incr(struct rte_uio_platform_dev *udev, u32 incr)
+{
+	u32 sub_ns = incr & GENMASK(GEM_SUBNSINCR_SIZE - 1, 0);
+
+	macb_uio_writel(udev, GEM_TISUBN, GEM_BF(SUBNSINCRL, sub_ns) |
+					GEM_BF(SUBNSINCRH, sub_ns >> GEM_SUBNSINCRL_SIZE));
+	macb_uio_writel(udev, GEM_TI, GEM_BF(NSINCR, incr >> GEM_SUBNSINCR_SIZE));
+}
+
+static int macb_uio_ptp_gettime(struct ptp_clock_info *info, struct timespec64 *ts)
+{
+	struct rte_uio_platform_dev *udev =
+		container_of(info, struct rte_uio_platform_dev, ptp_info);
+	unsigned long flags;
+
+	spin_lock_irqsave(&udev->tsu_lock, flags);
+	macb_uio_tsu_get(udev, ts);
+	spin_unlock_irqrestore(&udev->tsu_lock, flags);
+
+	return 0;
+}
+
+static int macb_uio_ptp_settime(struct ptp_clock_info *info,
+								const struct timespec64 *ts)
+{
+	struct rte_uio_platform_dev *udev =
+		container_of(info, struct rte_uio_platform_dev, ptp_info);
+	unsigned long flags;
+
+	spin_lock_irqsave(&udev->tsu_lock, flags);
+	macb_uio_tsu_set(udev, ts);
+	spin_unlock_irqrestore(&udev->tsu_lock, flags);
+
+	return 0;
+}
+
+/* scaled_ppm is ppm with a 16-bit fraction, relative to the nominal rate */
+static int macb_uio_ptp_adjfine(struct ptp_clock_info *info, long scaled_ppm)
+{
+	struct rte_uio_platform_dev *udev =
+		container_of(info, struct rte_uio_platform_dev, ptp_info);
+	bool neg = scaled_ppm < 0;
+	unsigned long flags;
+	u64 adj;
+
+	adj = (u64)(neg ? -scaled_ppm : scaled_ppm) * udev->tsu_incr;
+	adj = div_u64((adj >> 16) + (USEC_PER_SEC >> 1), USEC_PER_SEC);
+
+	spin_lock_irqsave(&udev->tsu_lock, flags);
+	macb_uio_tsu_set_incr(udev, neg ? udev->tsu_incr - adj : udev->tsu_incr + adj);
+	spin_unlock_irqrestore(&udev->tsu_lock, flags);
+
+	return 0;
+}
+
+static int macb_uio_ptp_adjtime(struct ptp_clock_info *info, s64 delta)
+{
+	struct rte_uio_platform_dev *udev =
+		container_of(info, struct rte_uio_platform_dev, ptp_info);
+	u64 offset = delta < 0 ? -delta : delta;
+	struct timespec64 ts;
+	unsigned long flags;
+
+	spin_lock_irqsave(&udev->tsu_lock, flags);
+	if (offset > MACB_TSU_NSEC_MAX) {
+		macb_uio_tsu_get(udev, &ts);
+		ts = timespec64_add(ts, ns_to_timespec64(delta));
+		macb_uio_tsu_set(udev, &ts);
+	} else {
+		macb_uio_writel(udev, GEM_TA, GEM_BF(ITDT, offset) |
+						(delta < 0 ? GEM_BIT(ADDSUB) : 0));
+	}
+	spin_unlock_irqrestore(&udev->tsu_lock, flags);
+
+	return 0;
+}
+
+static int macb_uio_ptp_enable(struct ptp_clock_info *info,
+							   struct ptp_clock_request *rq, int on)
+{
+	return -EOPNOTSUPP;
+}
+
+/* The TSU runs on tsu_clk when the platform provides one, else on pclk */
+static unsigned long macb_uio_tsu_rate(struct rte_uio_platform_dev *udev)
+{
+	struct device *dev = &udev->pdev->dev;
+	struct clk *tsu_clk;
+	unsigned long rate = 0;
+
+	tsu_clk = devm_clk_get_optional(dev, "tsu_clk");
+	if (!IS_ERR_OR_NULL(tsu_clk))
+		rate = clk_get_rate(tsu_clk);
+	if (!rate)
+		rate = udev->pclk_hz;
+
+	return rate;
+}
+
+/*
+ * Leave the increment alone when firmware or an earlier owner already
+ * set it, only a stopped TSU is programmed from the clock rate.
+ */
+static void macb_uio_setup_ptp(struct rte_uio_platform_dev *udev)
+{
+	struct device *dev = &udev->pdev->dev;
+	struct timespec64 now;
+	unsigned long rate;
+	u32 ti, sub_ns;
+
+	spin_lock_init(&udev->tsu_lock);
+	if (!ptp_clock || !udev->caps.tsu)
+		return;
+
+	ti = macb_uio_readl(udev, GEM_TI);
+	if (GEM_BFEXT(NSINCR, ti)) {
+		sub_ns = macb_uio_readl(udev, GEM_TISUBN);
+		udev->tsu_incr = (GEM_BFEXT(NSINCR, ti) << GEM_SUBNSINCR_SIZE) |
+			(GEM_BFEXT(SUBNSINCRH, sub_ns) << GEM_SUBNSINCRL_SIZE) |
+			GEM_BFEXT(SUBNSINCRL, sub_ns);
+	} else {
+		rate = macb_uio_tsu_rate(udev);
+		udev->tsu_incr = div_u64((u64)NSEC_PER_SEC << GEM_SUBNSINCR_SIZE, rate);
+		macb_uio_tsu_set_incr(udev, udev->tsu_incr);
+		ktime_get_real_ts64(&now);
+		macb_uio_tsu_set(udev, &now);
+	}
+
+	udev->ptp_info = (struct ptp_clock_info) {
+		.owner = THIS_MODULE,
+		.max_adj = MACB_TSU_MAX_ADJ,
+		.adjfine = macb_uio_ptp_adjfine,
+		.adjtime = macb_uio_ptp_adjtime,
+		.gettime64 = macb_uio_ptp_gettime,
+		.settime64 = macb_uio_ptp_settime,
+		.enable = macb_uio_ptp_enable,
+	};
+	snprintf(udev->ptp_info.name, sizeof(udev->ptp_info.name), "%s", dev_name(dev));
+
+	udev->ptp = ptp_clock_register(&udev->ptp_info, dev);
+	if (IS_ERR(udev->ptp)) {
+		dev_warn(dev, "Failed to register PTP clock (%ld).\n", PTR_ERR(udev->ptp));
+		udev->ptp = NULL;
+	}
+}
+
+static void macb_uio_release_ptp(struct rte_uio_platform_dev *udev)
+{
+	if (udev->ptp)
+		ptp_clock_unregister(udev->ptp);
+	udev->ptp = NULL;
+}
+
+/* Give queue N > 0 its own /dev/uioX so it can be waited on alone */
+static int macb_uio_register_queue(struct platform_device *dev,
+								   struct macb_uio_queue *queue)
+{
+	snprintf(queue->name, sizeof(queue->name), DRIVER_NAME "_q%u",
+			 queue->index);
+	queue->info.name = queue->name;
+	queue->info.version = DRIVER_VERSION;
+	queue->info.irqcontrol = macb_uio_queue_irqcontrol;
+	queue->info.irq = UIO_IRQ_CUSTOM;
+	queue->info.priv = queue;
+
+	return uio_register_device(&dev->dev, &queue->info);
+}
+
+/*
+ * Request the GEM queue interrupts, the Nth present queue uses the Nth
+ * platform IRQ like the kernel macb driver does.
+ */
+static int macb_uio_setup_irqs(struct platform_device *dev,
+							   struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_queue *queue;
+	unsigned int hw_q;
+	int i = 0, irq, nr, err;
+
+	nr = platform_irq_count(dev);
+	if (nr == -EPROBE_DEFER)
+		return nr;
+	if (nr <= 0 || !udev->regs)
+		return 0;
+
+	for (hw_q = 0; hw_q < MACB_UIO_MAX_QUEUES && i < nr; hw_q++) {
+		if (!(udev->caps.queue_mask & BIT(hw_q)))
+			continue;
+
+		irq = platform_get_irq(dev, i);
+		if (irq < 0) {
+			err = irq;
+			goto fail_free_irqs;
+		}
+
+		queue = &udev->queues[i];
+		queue->udev = udev;
+		queue->index = hw_q;
+		queue->irq = irq;
+		if (hw_q == 0) {
+			queue->isr = MACB_ISR;
+			queue->ier = MACB_IER;
+			queue->idr = MACB_IDR;
+			queue->imr = MACB_IMR;
+		} else {
+			queue->isr = GEM_ISR(hw_q - 1);
+			queue->ier = GEM_IER(hw_q - 1);
+			queue->idr = GEM_IDR(hw_q - 1);
+			queue->imr = GEM_IMR(hw_q - 1);
+		}
+
+		/* Leave every source masked until userspace asks for it */
+		macb_uio_writel(udev, queue->idr, ~0U);
+
+		if (hw_q != 0 && queue_uio) {
+			err = macb_uio_register_queue(dev, queue);
+			if (err) {
+				dev_err(&dev->dev, "Failed to register uio device for queue %u.\n",
+						hw_q);
+				goto fail_free_irqs;
+			}
+			queue->has_uio = true;
+		}
+
+		err = request_irq(irq, macb_uio_interrupt, IRQF_SHARED,
+						  dev_name(&dev->dev), queue);
+		if (err) {
+			dev_err(&dev->dev, "Unable to request IRQ %d (error %d)\n",
+					irq, err);
+			if (queue->has_uio)
+				uio_unregister_device(&queue->info);
+			queue->has_uio = false;
+			goto fail_free_irqs;
+		}
+		udev->nr_irqs = ++i;
+		macb_uio_irq_hint(irq, udev->hk_mask);
+	}
+
+	return 0;
+
+fail_free_irqs:
+	macb_uio_free_irqs(udev);
+
+	return err;
+}
+
+/**
+ * A user buffer mapped for DMA through the control device.
+ */
+struct macb_uio_user_dma {
+	struct list_head node;
+	struct page **pages;
+	unsigned long nr_pages;
+	struct sg_table sgt;
+	dma_addr_t iova;
+	u64 size;
+};
+
+/**
+ * Per open file state of the control device, mappings die with the fd.
+ */
+struct macb_uio_ctl_file {
+	struct device *dev;
+	struct mutex lock; /* protects mappings */
+	struct list_head mappings;
+	/* Event subscription, everything below is under macb_uio_sub_lock */
+	struct rte_uio_platform_dev *udev; /* NULL once the device is gone */
+	struct list_head node;
+	struct macb_uio_event_filter filter;
+	struct macb_uio_event pending;
+	wait_queue_head_t wait;
+};
+
+/*
+ * Every opener of /dev/macb_uioN is a subscriber with its own cause
+ * filter, so an auxiliary process waits there without taking wakeups
+ * from the /dev/uioN the primary sleeps on. The lock is global since
+ * a subscriber may outlive its device.
+ */
+static DEFINE_SPINLOCK(macb_uio_sub_lock);
+
+static void macb_uio_notify_subscribers(struct rte_uio_platform_dev *udev,
+										u32 sw_cause, u32 queue_mask)
+{
+	struct macb_uio_ctl_file *cf;
+	unsigned long flags;
+	u32 sw, queues;
+
+	if (list_empty(&udev->subscribers))
+		return;
+
+	spin_lock_irqsave(&macb_uio_sub_lock, flags);
+	list_for_each_entry(cf, &udev->subscribers, node) {
+		sw = sw_cause & cf->filter.sw_cause;
+		queues = queue_mask & cf->filter.queue_mask;
+		if (!sw && !queues)
+			continue;
+		cf->pending.count++;
+		cf->pending.sw_cause |= sw;
+		cf->pending.queue_mask |= queues;
+		wake_up_interruptible(&cf->wait);
+	}
+	spin_unlock_irqrestore(&macb_uio_sub_lock, flags);
+}
+
+/* Called on remove, readers then see -ENODEV once drained */
+static void macb_uio_detach_subscribers(struct rte_uio_platform_dev *udev)
+{
+	struct macb_uio_ctl_file *cf, *tmp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&macb_uio_sub_lock, flags);
+	list_for_each_entry_safe(cf, tmp, &udev->subscribers, node) {
+		list_del_init(&cf->node);
+		cf->udev = NULL;
+		wake_up_interruptible(&cf->wait);
+	}
+	spin_unlock_irqrestore(&macb_uio_sub_lock, flags);
+}
+
+static void macb_uio_unpin_pages(struct page **pages, unsigned long nr_pages)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	unpin_user_pages_dirty_lock(pages, nr_pages, true);
+#else
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++) {
+		set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+#endif
+}
+
+static void macb_uio_user_dma_free(struct device *dev,
+								   struct macb_uio_user_dma *map)
+{
+	dma_unmap_sg(dev, map->sgt.sgl, map->sgt.orig_nents, DMA_BIDIRECTIONAL);
+	sg_free_table(&map->sgt);
+	macb_uio_unpin_pages(map->pages, map->nr_pages);
+	kvfree(map->pages);
+	kfree(map);
+}
+
+/*
+ * Pin the user buffer and map it through the DMA API, so with the IOMMU
+ * in translated mode it lands in the device's domain. The device needs
+ * one contiguous range, which hugepages give without an IOMMU and the
+ * IOMMU gives for any buffer.
+ */
+static int macb_uio_ctl_dma_map(struct macb_uio_ctl_file *cf,
+								struct macb_uio_dma_map *req)
+{
+	struct macb_uio_user_dma *map;
+	struct scatterlist *sg;
+	dma_addr_t next;
+	bool bound, direct;
+	long pinned;
+	int nents, i, err;
+
+	if (!req->size || !PAGE_ALIGNED(req->vaddr) || !PAGE_ALIGNED(req->size) ||
+	    req->vaddr + req->size < req->vaddr)
+		return -EINVAL;
+
+	spin_lock_irq(&macb_uio_sub_lock);
+	bound = cf->udev;
+	spin_unlock_irq(&macb_uio_sub_lock);
+	if (!bound)
+		return -ENODEV;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	map->size = req->size;
+	map->nr_pages = req->size >> PAGE_SHIFT;
+	map->pages = kvmalloc_array(map->nr_pages, sizeof(*map->pages), GFP_KERNEL);
+	if (!map->pages) {
+		err = -ENOMEM;
+		goto fail_free_map;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	pinned = pin_user_pages_fast(req->vaddr, map->nr_pages,
+				     FOLL_WRITE | FOLL_LONGTERM, map->pages);
+#else
+	pinned = get_user_pages_fast(req->vaddr, map->nr_pages, FOLL_WRITE,
+				     map->pages);
+#endif
+	if (pinned < 0) {
+		err = pinned;
+		goto fail_free_pages;
+	}
+	if (pinned != map->nr_pages) {
+		macb_uio_unpin_pages(map->pages, pinned);
+		err = -EFAULT;
+		goto fail_free_pages;
+	}
+
+	err = sg_alloc_table_from_pages(&map->sgt, map->pages, map->nr_pages, 0,
+					req->size, GFP_KERNEL);
+	if (err)
+		goto fail_unpin;
+
+	nents = dma_map_sg(cf->dev, map->sgt.sgl, map->sgt.orig_nents,
+			   DMA_BIDIRECTIONAL);
+	if (!nents) {
+		err = -ENOMEM;
+		goto fail_free_sgt;
+	}
+
+	/*
+	 * Without a translating IOMMU a buffer the device cannot reach is
+	 * silently bounced through swiotlb, and the device would then write
+	 * the bounce buffer instead of the user pages.
+	 */
+	direct = !device_iommu_mapped(cf->dev);
+	map->iova = sg_dma_address(map->sgt.sgl);
+	next = map->iova;
+	for_each_sg(map->sgt.sgl, sg, nents, i) {
+		if (sg_dma_address(sg) != next) {
+			err = -EFBIG;
+			goto fail_unmap;
+		}
+		if (direct && (sg_dma_address(sg) != phys_to_dma(cf->dev, sg_phys(sg)) ||
+			       sg_dma_address(sg) + sg_dma_len(sg) - 1 > dma_get_mask(cf->dev))) {
+			err = -ERANGE;
+			goto fail_unmap;
+		}
+		next += sg_dma_len(sg);
+	}
+
+	req->iova = map->iova;
+
+	mutex_lock(&cf->lock);
+	list_add(&map->node, &cf->mappings);
+	mutex_unlock(&cf->lock);
+
+	return 0;
+
+fail_unmap:
+	dma_unmap_sg(cf->dev, map->sgt.sgl, map->sgt.orig_nents, DMA_BIDIRECTIONAL);
+fail_free_sgt:
+	sg_free_table(&map->sgt);
+fail_unpin:
+	macb_uio_unpin_pages(map->pages, map->nr_pages);
+fail_free_pages:
+	kvfree(map->pages);
+fail_free_map:
+	kfree(map);
+
+	return err;
+}
+
+static int macb_uio_ctl_dma_unmap(struct macb_uio_ctl_file *cf,
+								  struct macb_uio_dma_map *req)
+{
+	struct macb_uio_user_dma *map;
+
+	mutex_lock(&cf->lock);
+	list_for_each_entry(map, &cf->mappings, node) {
+		if (map->iova == req->iova) {
+			list_del(&map->node);
+			mutex_unlock(&cf->lock);
+			macb_uio_user_dma_free(cf->dev, map);
+			return 0;
+		}
+	}
+	mutex_unlock(&cf->lock);
+
+	return -ENOENT;
+}
+
+/* The descriptor is built at probe, only its copy needs the device alive */
+static int macb_uio_ctl_get_desc(struct macb_uio_ctl_file *cf, void __user *argp)
+{
+	struct macb_uio_desc_req req;
+	struct macb_uio_desc *desc;
+	int err = 0;
+
+	if (copy_from_user(&req, argp, sizeof(req)))
+		return -EFAULT;
+
+	desc = kmalloc(sizeof(*desc), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+
+	spin_lock_irq(&macb_uio_sub_lock);
+	if (cf->udev)
+		*desc = cf->udev->desc;
+	else
+		err = -ENODEV;
+	spin_unlock_irq(&macb_uio_sub_lock);
+
+	if (!err && copy_to_user(u64_to_user_ptr(req.addr), desc,
+							 min_t(size_t, req.size, sizeof(*desc))))
+		err = -EFAULT;
+	req.size = sizeof(*desc);
+	if (!err && copy_to_user(argp, &req, sizeof(req)))
+		err = -EFAULT;
+
+	kfree(desc);
+
+	return err;
+}
+
+static long macb_uio_ctl_ioctl(struct file *file, unsigned int cmd,
+							   unsigned long arg)
+{
+	struct macb_uio_ctl_file *cf = file->private_data;
+	void __user *argp = (void __user *)arg;
+	struct macb_uio_event_filter filter;
+	struct macb_uio_dma_map req;
+	int err;
+
+	switch (cmd) {
+	case MACB_UIO_IOC_DMA_MAP:
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+		err = macb_uio_ctl_dma_map(cf, &req);
+		if (err)
+			return err;
+		if (copy_to_user(argp, &req, sizeof(req))) {
+			macb_uio_ctl_dma_unmap(cf, &req);
+			return -EFAULT;
+		}
+		return 0;
+	case MACB_UIO_IOC_DMA_UNMAP:
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+		return macb_uio_ctl_dma_unmap(cf, &req);
+	case MACB_UIO_IOC_GET_DESC:
+		return macb_uio_ctl_get_desc(cf, argp);
+	case MACB_UIO_IOC_SET_FILTER:
+		if (copy_from_user(&filter, argp, sizeof(filter)))
+			return -EFAULT;
+		spin_lock_irq(&macb_uio_sub_lock);
+		cf->filter = filter;
+		spin_unlock_irq(&macb_uio_sub_lock);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int macb_uio_ctl_open(struct inode *inode, struct file *file)
+{
+	struct rte_uio_platform_dev *udev =
+		container_of(file->private_data, struct rte_uio_platform_dev, ctl);
+	struct macb_uio_ctl_file *cf;
+
+	cf = kzalloc(sizeof(*cf), GFP_KERNEL);
+	if (!cf)
+		return -ENOMEM;
+
+	/* Mappings may outlive the driver binding, keep the device around */
+	cf->dev = get_device(&udev->pdev->dev);
+	mutex_init(&cf->lock);
+	INIT_LIST_HEAD(&cf->mappings);
+	init_waitqueue_head(&cf->wait);
+	file->private_data = cf;
+
+	/* Subscribed to nothing until MACB_UIO_IOC_SET_FILTER */
+	spin_lock_irq(&macb_uio_sub_lock);
+	cf->udev = udev;
+	list_add_tail(&cf->node, &udev->subscribers);
+	spin_unlock_irq(&macb_uio_sub_lock);
+
+	return 0;
+}
+
+/* Take the causes that matched the filter since the last read */
+static ssize_t macb_uio_ctl_read(struct file *file, char __user *buf,
+								 size_t count, loff_t *ppos)
+{
+	struct macb_uio_ctl_file *cf = file->private_data;
+	struct macb_uio_event ev;
+	bool gone;
+	int err;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	for (;;) {
+		spin_lock_irq(&macb_uio_sub_lock);
+		ev = cf->pending;
+		memset(&cf->pending, 0, sizeof(cf->pending));
+		gone = !cf->udev;
+		spin_unlock_irq(&macb_uio_sub_lock);
+
+		if (ev.count)
+			break;
+		if (gone)
+			return -ENODEV;
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		err = wait_event_interruptible(cf->wait,
+									   READ_ONCE(cf->pending.count) || !READ_ONCE(cf->udev));
+		if (err)
+			return err;
+	}
+
+	if (copy_to_user(buf, &ev, sizeof(ev)))
+		return -EFAULT;
+
+	return sizeof(ev);
+}
+
+static __poll_t macb_uio_ctl_poll(struct file *file, poll_table *wait)
+{
+	struct macb_uio_ctl_file *cf = file->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(file, &cf->wait, wait);
+
+	spin_lock_irq(&macb_uio_sub_lock);
+	if (cf->pending.count)
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (!cf->udev)
+		mask |= EPOLLHUP | EPOLLERR;
+	spin_unlock_irq(&macb_uio_sub_lock);
+
+	return mask;
+}
+
+static int macb_uio_ctl_release(struct inode *inode, struct file *file)
+{
+	struct macb_uio_ctl_file *cf = file->private_data;
+	struct macb_uio_user_dma *map, *tmp;
+
+	/*
+	 * Descriptors may still point at the mappings, whatever order the
+	 * fds of an exiting PMD close in and with persist too. The MAC has
+	 * to stop before the pages go back to the allocator.
+	 */
+	spin_lock_irq(&macb_uio_sub_lock);
+	if (cf->udev) {
+		if (!list_empty(&cf->mappings))
+			macb_uio_stop_dma(cf->udev);
+		list_del(&cf->node);
+	}
+	spin_unlock_irq(&macb_uio_sub_lock);
+
+	list_for_each_entry_safe(map, tmp, &cf->mappings, node) {
+		list_del(&map->node);
+		macb_uio_user_dma_free(cf->dev, map);
+	}
+
+	put_device(cf->dev);
+	kfree(cf);
+
+	return 0;
+}
+
+static const struct file_operations macb_uio_ctl_fops = {
+	.owner = THIS_MODULE,
+	.open = macb_uio_ctl_open,
+	.release = macb_uio_ctl_release,
+	.read = macb_uio_ctl_read,
+	.poll = macb_uio_ctl_poll,
+	.llseek = noop_llseek,
+	.unlocked_ioctl = macb_uio_ctl_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 5, 0)
+	.compat_ioctl = compat_ptr_ioctl,
+#endif
+};
+
+/* /dev/macb_uioN carries the ioctls /dev/uioN has no room for */
+static int macb_uio_register_ctl(struct rte_uio_platform_dev *udev)
+{
+	snprintf(udev->ctl_name, sizeof(udev->ctl_name), DRIVER_NAME "%d",
+			 udev->info.uio_dev->minor);
+	udev->ctl.minor = MISC_DYNAMIC_MINOR;
+	udev->ctl.name = udev->ctl_name;
+	udev->ctl.fops = &macb_uio_ctl_fops;
+	udev->ctl.parent = &udev->pdev->dev;
+
+	return misc_register(&udev->ctl);
+}
+
+/*
+ * Register maps get the attributes chosen by regs_mapping, never write
+ * combining since ISR/IER and friends do not tolerate it. The status
+ * page is read-only, the events page read-write and DMA regions are
+ * mapped the way the DMA API allocated them, write combining included.
+ */
+static void macb_uio_dma_mem_release(struct kref *ref)
+{
+	struct macb_uio_dma_mem *dmem = container_of(ref, struct macb_uio_dma_mem, ref);
+
+	dma_free_coherent(dmem->dev, dmem->size, dmem->cpu_addr, dmem->dma_addr);
+	put_device(dmem->dev);
+	kfree(dmem);
+}
+
+/* Forks and partial unmaps duplicate the VMA, each copy holds a reference */
+static void macb_uio_dma_vm_open(struct vm_area_struct *vma)
+{
+	struct macb_uio_dma_mem *dmem = vma->vm_private_data;
+
+	kref_get(&dmem->ref);
+}
+
+static void macb_uio_dma_vm_close(struct vm_area_struct *vma)
+{
+	struct macb_uio_dma_mem *dmem = vma->vm_private_data;
+
+	kref_put(&dmem->ref, macb_uio_dma_mem_release);
+}
+
+static const struct vm_operations_struct macb_uio_dma_vm_ops = {
+	.open = macb_uio_dma_vm_open,
+	.close = macb_uio_dma_vm_close,
+};
+
+static int macb_uio_mmap(struct uio_info *info, struct vm_area_struct *vma)
+{
+	struct rte_uio_platform_dev *udev = info->priv;
+	unsigned long mi = vma->vm_pgoff;
+	struct macb_uio_map *map = &udev->maps[mi];
+	struct uio_mem *mem = &info->mem[mi];
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long pfn;
+	int err;
+
+	switch (map->type) {
+	case MACB_UIO_MAP_REGS:
+		if (map->prot == MACB_UIO_PROT_DEVICE)
+			vma->vm_page_prot = pgprot_device(vma->vm_page_prot);
+		else
+			vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+		pfn = mem->addr >> PAGE_SHIFT;
+		break;
+	/*
+	 * The kernel pages are inserted rather than remapped, the mapping
+	 * then holds a page reference and outlives free_page() on remove.
+	 */
+	case MACB_UIO_MAP_PAGE:
+		if (vma->vm_flags & VM_WRITE)
+			return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+		vm_flags_clear(vma, VM_MAYWRITE);
+#else
+		vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+		return vm_insert_page(vma, vma->vm_start, virt_to_page(map->cpu_addr));
+	case MACB_UIO_MAP_SHARED:
+		return vm_insert_page(vma, vma->vm_start, virt_to_page(map->cpu_addr));
+	case MACB_UIO_MAP_DMA:
+		/* uio passes the map index in vm_pgoff, the DMA API wants 0 */
+		vma->vm_pgoff = 0;
+		err = dma_mmap_coherent(&udev->pdev->dev, vma, map->cpu_addr,
+					map->dma_addr, size);
+		vma->vm_pgoff = mi;
+		if (err)
+			return err;
+		vma->vm_private_data = map->dmem;
+		vma->vm_ops = &macb_uio_dma_vm_ops;
+		kref_get(&map->dmem->ref);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+
+	return remap_pfn_range(vma, vma->vm_start, pfn, size, vma->vm_page_prot);
+}
+
+/* Append a uio map after the register maps, returns its index */
+static int macb_uio_add_map(struct rte_uio_platform_dev *udev, const char *name,
+							int type, void *cpu_addr, dma_addr_t dma_addr,
+							resource_size_t size)
+{
+	struct uio_mem *mem;
+	int mi = udev->nr_maps;
+
+	if (mi >= MAX_UIO_MAPS)
+		return -ENOSPC;
+
+	mem = &udev->info.mem[mi];
+	mem->name = name;
+	mem->size = size;
+	if (type == MACB_UIO_MAP_PAGE || type == MACB_UIO_MAP_SHARED) {
+		/* macb_uio_mmap() does not need it, keep it out of sysfs */
+		mem->memtype = UIO_MEM_LOGICAL;
+		mem->addr = 0;
+	} else {
+		/* maps/mapX/addr reports the bus address of DMA regions */
+		mem->memtype = UIO_MEM_PHYS;
+		mem->addr = dma_addr;
+	}
+
+	udev->maps[mi].type = type;
+	udev->maps[mi].prot = type == MACB_UIO_MAP_DMA ? MACB_UIO_PROT_DMA : MACB_UIO_PROT_CACHED;
+	udev->maps[mi].cpu_addr = cpu_addr;
+	udev->maps[mi].dma_addr = dma_addr;
 
+	return udev->nr_maps++;
+}
 
-static ssize_t dev_type_show(struct device *dev, struct device_attribute *attr,
-							 char *buf)
+/* Allocate the page userspace takes interrupt causes from */
+static int macb_uio_setup_events(struct rte_uio_platform_dev *udev)
 {
-	struct device_node *np = dev->of_node;
-	const char *pm;
 	int err;
 
-	if (np) {
-		err = device_property_read_string(dev, "compatible", &pm);
-		if (err < 0)
-			return snprintf(buf, 64, "Unknown");
+	udev->events = (struct macb_uio_events *)get_zeroed_page(GFP_KERNEL);
+	if (!udev->events)
+		return -ENOMEM;
+
+	udev->events->version = MACB_UIO_EVENTS_VERSION;
+	udev->events->size = sizeof(struct macb_uio_events);
 
-		return snprintf(buf, 64, "%s", pm);
-	} else if (has_acpi_companion(dev)) {
-		pm = acpi_device_hid(ACPI_COMPANION(dev));
-		return snprintf(buf, 64, "%s", pm);
-	}
+	err = macb_uio_add_map(udev, MACB_UIO_MAP_EVENTS, MACB_UIO_MAP_SHARED,
+						   udev->events, 0, PAGE_SIZE);
+	if (err < 0)
+		dev_warn(&udev->pdev->dev, "No uio map left for the events page.\n");
 
-	return snprintf(buf, 64, "Unknown");
+	return 0;
 }
 
-static DEVICE_ATTR_RO(dev_type);
+static void macb_uio_release_events(struct rte_uio_platform_dev *udev)
+{
+	free_page((unsigned long)udev->events);
+	udev->events = NULL;
+}
 
-/* sriov sysfs */
-static ssize_t pclk_hz_show(struct device *dev, struct device_attribute *attr,
-							char *buf)
+/* Allocate the status page and export it as a read-only map */
+static int macb_uio_setup_status(struct rte_uio_platform_dev *udev)
 {
-	struct macb_platform_data *pdata;
-	struct clk *pclk;
-	unsigned long pclk_hz;
+	struct macb_uio_link link;
+	int err;
 
-	pdata = dev_get_platdata(dev);
-	if (pdata) {
-		pclk = pdata->pclk;
-	} else {
-		pclk = devm_clk_get(dev, "pclk");
-		if (IS_ERR(pclk)) {
-			dev_info(dev, "can't get pclk value.\n");
-			pclk = NULL;
-		}
-	}
+	udev->status = (struct macb_uio_status *)get_zeroed_page(GFP_KERNEL);
+	if (!udev->status)
+		return -ENOMEM;
+
+	udev->status->version = MACB_UIO_STATUS_VERSION;
+	udev->status->size = sizeof(struct macb_uio_status);
+	udev->status->state_generation = 1;
+
+	macb_uio_read_link(udev, &link);
+	macb_uio_publish_link(udev, &link);
+
+	err = macb_uio_add_map(udev, MACB_UIO_MAP_STATUS, MACB_UIO_MAP_PAGE,
+						   udev->status, 0, PAGE_SIZE);
+	if (err < 0)
+		dev_warn(&udev->pdev->dev, "No uio map left for the status page.\n");
 
-	pclk_hz = clk_get_rate(pclk);
-	if (!pclk_hz)
-		pclk_hz = 250000000;
-	return snprintf(buf, 12, "%lu", pclk_hz);
+	return 0;
 }
 
-static DEVICE_ATTR_RO(pclk_hz);
+static void macb_uio_release_status(struct rte_uio_platform_dev *udev)
+{
+	free_page((unsigned long)udev->status);
+	udev->status = NULL;
+}
 
-static ssize_t phy_mode_show(struct device *dev, struct device_attribute *attr,
-							 char *buf)
+/* Allocate a coherent DMA region and export it as a uio map */
+static int macb_uio_alloc_dma(struct rte_uio_platform_dev *udev,
+							  struct macb_uio_dma *region, const char *name,
+							  size_t size)
 {
-	const char *pm;
+	struct device *dev = &udev->pdev->dev;
+	struct macb_uio_dma_mem *dmem;
 	int err;
 
-	err = device_property_read_string(dev, "phy-mode", &pm);
-	if (err < 0)
-		return snprintf(buf, 64, "Unknown");
+	dmem = kzalloc(sizeof(*dmem), GFP_KERNEL);
+	if (!dmem)
+		return -ENOMEM;
+
+	dmem->cpu_addr = dma_alloc_coherent(dev, size, &dmem->dma_addr, GFP_KERNEL);
+	if (!dmem->cpu_addr) {
+		dev_err(dev, "Failed to allocate %zu bytes for the %s map.\n",
+				size, name);
+		kfree(dmem);
+		return -ENOMEM;
+	}
+	kref_init(&dmem->ref);
+	dmem->dev = get_device(dev);
+	dmem->size = size;
+
+	err = macb_uio_add_map(udev, name, MACB_UIO_MAP_DMA, dmem->cpu_addr,
+						   dmem->dma_addr, size);
+	if (err < 0) {
+		dev_warn(dev, "No uio map left for the %s map.\n", name);
+		kref_put(&dmem->ref, macb_uio_dma_mem_release);
+		return err;
+	}
+	udev->maps[err].dmem = dmem;
+
+	region->cpu_addr = dmem->cpu_addr;
+	region->dma_addr = dmem->dma_addr;
+	region->size = size;
+	region->dmem = dmem;
 
-	return snprintf(buf, 64, "%s", pm);
+	dev_info(dev, "%s dma=%#llx size=%zu\n", name,
+			 (unsigned long long)region->dma_addr, size);
+
+	return 0;
 }
 
-static DEVICE_ATTR_RO(phy_mode);
+static void macb_uio_free_dma(struct rte_uio_platform_dev *udev,
+							  struct macb_uio_dma *region)
+{
+	if (!region->cpu_addr)
+		return;
 
-static ssize_t physical_addr_show(struct device *dev, struct device_attribute *attr,
-							char *buf)
+	/* Freed here unless userspace still maps it */
+	kref_put(&region->dmem->ref, macb_uio_dma_mem_release);
+	region->dmem = NULL;
+	region->cpu_addr = NULL;
+}
+
+/*
+ * Allocate the descriptor ring region, one RX and one TX ring of
+ * ring_size bytes for every queue. The region lives as long as the
+ * device is bound to the driver or mapped by userspace. Ports whose register maps use up the
+ * uio maps still probe, the PMD then places the rings itself.
+ */
+static int macb_uio_setup_rings(struct rte_uio_platform_dev *udev)
 {
-	phys_addr_t physical_addr = 0;
-	struct resource *res;
-	int i;
-	struct platform_device *pdev = to_platform_device(dev);
+	int err;
 
-	for (i = 0; i < MAX_UIO_MAPS; i++) {
-		res = platform_get_resource(pdev, IORESOURCE_MEM, i);
-		if (!res)
-			continue;
+	udev->ring_size = PAGE_ALIGN(ring_size);
 
-		physical_addr = res->start;
-		break;
+	err = macb_uio_alloc_dma(udev, &udev->rings, MACB_UIO_MAP_RINGS,
+				 2 * udev->ring_size * udev->caps.num_queues);
+	if (err == -ENOSPC) {
+		dev_warn(&udev->pdev->dev, "Continuing without descriptor rings.\n");
+		udev->ring_size = 0;
+		return 0;
 	}
 
-	return snprintf(buf, 16, "0x%llx", physical_addr);
+	return err;
 }
 
-static DEVICE_ATTR_RO(physical_addr);
+/*
+ * Reserve the packet buffer pool. Sizes this large come from CMA when
+ * the kernel has it, so the pool is physically contiguous and needs
+ * neither hugepages nor an IOMMU. The pool is optional, the device
+ * still probes without it.
+ */
+static void macb_uio_setup_pool(struct rte_uio_platform_dev *udev)
+{
+	if (macb_uio_alloc_dma(udev, &udev->pool, MACB_UIO_MAP_POOL,
+			       (size_t)pool_size << 20))
+		dev_warn(&udev->pdev->dev, "Continuing without packet buffer pool.\n");
+}
 
-static ssize_t speed_info_show(struct device *dev, struct device_attribute *attr,
-						char *buf)
+static struct dentry *macb_uio_debugfs;
+
+static int macb_uio_counters_show(struct seq_file *s, void *unused)
 {
-	struct fixed_phy_status status = {};
-	struct fwnode_handle *fwnode = dev_fwnode(dev);
-	struct fwnode_handle *fixed_node;
+	struct rte_uio_platform_dev *udev = s->private;
 
-	if (fwnode) {
-		fixed_node = fwnode_get_named_child_node(fwnode, "fixed-link");
-		if (fixed_node) {
-			fwnode_property_read_u32(fixed_node, "speed", &status.speed);
-
-			status.duplex = DUPLEX_HALF;
-			if (fwnode_property_read_bool(fixed_node, "full-duplex"))
-				status.duplex = DUPLEX_FULL;
-
-			fwnode_handle_put(fixed_node);
-			if (status.duplex == DUPLEX_FULL)
-				return snprintf(buf, 64, "fixed-link:%d full-duplex\n",
-						status.speed);
-			else
-				return snprintf(buf, 64, "fixed-link:%d half-duplex\n",
-						status.speed);
-		} else {
-			return snprintf(buf, 64, "unknown");
-		}
-	} else {
-		return snprintf(buf, 64, "unknown");
-	}
+	seq_printf(s, "events %lld\n", atomic64_read(&udev->dbg.events));
+	seq_printf(s, "spurious %lld\n", atomic64_read(&udev->dbg.spurious));
+	seq_printf(s, "coalesced %lld\n", atomic64_read(&udev->dbg.coalesced));
+
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(macb_uio_counters);
 
-static DEVICE_ATTR_RO(speed_info);
+static int macb_uio_hist_show(struct seq_file *s, void *unused)
+{
+	atomic64_t *hist = s->private;
+	unsigned int i;
 
-static struct attribute *dev_attrs[] = {
-	&dev_attr_pclk_hz.attr,
-	&dev_attr_phy_mode.attr,
-	&dev_attr_physical_addr.attr,
-	&dev_attr_dev_type.attr,
-	&dev_attr_speed_info.attr,
-	NULL,
-};
+	for (i = 0; i < MACB_UIO_HIST_BUCKETS; i++)
+		seq_printf(s, "%llu %lld\n", i ? 1ULL << (i - 1) : 0,
+				   atomic64_read(&hist[i]));
 
-static const struct attribute_group dev_attr_grp = {
-	.attrs = dev_attrs,
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(macb_uio_hist);
+
+/*
+ * Registers that can be read without side effects. ISR (clear on read
+ * on some GEMs) and the statistics are left out.
+ */
+static const struct {
+	const char *name;
+	u32 offset;
+	bool gem;
+} macb_uio_dump_regs[] = {
+	{ "NCR", MACB_NCR },
+	{ "NCFGR", MACB_NCFGR },
+	{ "NSR", MACB_NSR },
+	{ "USRIO", MACB_USRIO },
+	{ "DMACFG", GEM_DMACFG, true },
+	{ "TSR", MACB_TSR },
+	{ "RBQP", MACB_RBQP },
+	{ "TBQP", MACB_TBQP },
+	{ "RSR", MACB_RSR },
+	{ "IMR", MACB_IMR },
+	{ "JML", GEM_JML, true },
+	{ "HS_MAC_CONFIG", GEM_HS_MAC_CONFIG, true },
+	{ "INTMOD", GEM_INTMOD, true },
+	{ "MID", MACB_MID },
+	{ "TI", GEM_TI, true },
+	{ "TISUBN", GEM_TISUBN, true },
+	{ "DCFG1", GEM_DCFG1, true },
+	{ "DCFG2", GEM_DCFG2, true },
+	{ "DCFG5", GEM_DCFG5, true },
+	{ "DCFG6", GEM_DCFG6, true },
+	{ "DCFG8", GEM_DCFG8, true },
+	{ "DCFG12", GEM_DCFG12, true },
+	{ "TBQPH", GEM_TBQPH, true },
+	{ "RBQPH", GEM_RBQPH, true },
+	{ "USX_CONTROL", GEM_USX_CONTROL, true },
+	{ "USX_STATUS", GEM_USX_STATUS, true },
 };
 
-static int macb_uio_poll(void *args)
+/* Read everything first so the dump is one short burst of MMIO */
+static int macb_uio_regs_show(struct seq_file *s, void *unused)
 {
-	struct uio_info *info = (struct uio_info *)args;
+	struct rte_uio_platform_dev *udev = s->private;
+	u32 val[ARRAY_SIZE(macb_uio_dump_regs)];
+	u32 tbqp[MACB_UIO_MAX_QUEUES], rbqp[MACB_UIO_MAX_QUEUES];
+	u32 imr[MACB_UIO_MAX_QUEUES];
+	u32 ncr, ncfgr, nsr, dmacfg;
+	unsigned int i, hw_q;
+
+	for (i = 0; i < ARRAY_SIZE(macb_uio_dump_regs); i++) {
+		if (!macb_uio_dump_regs[i].gem || udev->caps.is_gem)
+			val[i] = macb_uio_readl(udev, macb_uio_dump_regs[i].offset);
+	}
+	for (hw_q = 0; hw_q < MACB_UIO_MAX_QUEUES; hw_q++) {
+		if (!(udev->caps.queue_mask & BIT(hw_q)))
+			continue;
+		tbqp[hw_q] = macb_uio_readl(udev, macb_uio_tbqp(hw_q));
+		rbqp[hw_q] = macb_uio_readl(udev, hw_q ? GEM_RBQP(hw_q - 1) : MACB_RBQP);
+		imr[hw_q] = macb_uio_readl(udev, hw_q ? GEM_IMR(hw_q - 1) : MACB_IMR);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(macb_uio_dump_regs); i++) {
+		if (!macb_uio_dump_regs[i].gem || udev->caps.is_gem)
+			seq_printf(s, "%-14s 0x%04x 0x%08x\n", macb_uio_dump_regs[i].name,
+					   macb_uio_dump_regs[i].offset, val[i]);
+	}
 
-	while (!kthread_should_stop()) {
-		uio_event_notify(info);
-		msleep(UIO_POLL_INTERVAL);
+	seq_puts(s, "\nqueue TBQP       RBQP       IMR\n");
+	for (hw_q = 0; hw_q < MACB_UIO_MAX_QUEUES; hw_q++) {
+		if (udev->caps.queue_mask & BIT(hw_q))
+			seq_printf(s, "%5u 0x%08x 0x%08x 0x%08x\n", hw_q, tbqp[hw_q],
+					   rbqp[hw_q], imr[hw_q]);
 	}
 
+	ncr = val[0];
+	ncfgr = val[1];
+	nsr = val[2];
+	dmacfg = udev->caps.is_gem ? val[4] : 0;
+	seq_printf(s, "\nrx %s, tx %s, mdio %s, link %s, %s%s-duplex%s\n",
+			   ncr & MACB_BIT(RE) ? "on" : "off",
+			   ncr & MACB_BIT(TE) ? "on" : "off",
+			   nsr & MACB_BIT(IDLE) ? "idle" : "busy",
+			   nsr & MACB_BIT(NSR_LINK) ? "up" : "down",
+			   ncfgr & GEM_BIT(GBE) ? "1000 " : ncfgr & MACB_BIT(SPD) ? "100 " : "10 ",
+			   ncfgr & MACB_BIT(FD) ? "full" : "half",
+			   ncfgr & MACB_BIT(PAE) ? ", pause" : "");
+	if (udev->caps.is_gem)
+		seq_printf(s, "dma: rx buffer %u bytes, burst %u, addr64 %s\n",
+				   GEM_BFEXT(RXBS, dmacfg) * 64, GEM_BFEXT(FBLDO, dmacfg),
+				   dmacfg & GEM_BIT(ADDR64) ? "on" : "off");
+
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(macb_uio_regs);
 
-static int macb_uio_open(struct uio_info *info, struct inode *inode)
+/*
+ * <debugfs>/macb_uio/<device>/: counters, the IRQ to notify and notify
+ * to re-arm histograms as "lower bound in ns, count" lines, and regs.
+ */
+static void macb_uio_setup_debugfs(struct rte_uio_platform_dev *udev)
 {
-	struct rte_uio_platform_dev *udev = info->priv;
+	struct dentry *dir;
+
+	if (IS_ERR_OR_NULL(macb_uio_debugfs))
+		return;
+
+	dir = debugfs_create_dir(dev_name(&udev->pdev->dev), macb_uio_debugfs);
+	debugfs_create_file("counters", 0444, dir, udev, &macb_uio_counters_fops);
+	if (udev->regs)
+		debugfs_create_file("regs", 0400, dir, udev, &macb_uio_regs_fops);
+	debugfs_create_file("irq_to_notify", 0444, dir, udev->dbg.irq_to_notify,
+						&macb_uio_hist_fops);
+	debugfs_create_file("notify_to_arm", 0444, dir, udev->dbg.notify_to_arm,
+						&macb_uio_hist_fops);
+	udev->dbg.dir = dir;
+}
 
-	if (atomic_inc_return(&udev->refcnt) != 1)
-		return 0;
+/*
+ * Resolve the clock and the firmware properties once, reading them
+ * again from sysfs would take a devres entry on every read.
+ */
+static void macb_uio_read_props(struct platform_device *dev,
+								struct rte_uio_platform_dev *udev)
+{
+	struct macb_platform_data *pdata = dev_get_platdata(&dev->dev);
+	struct resource *res;
+	struct clk *pclk;
+	const char *str;
+	int i;
+
+	if (pdata) {
+		udev->pclk_hz = clk_get_rate(pdata->pclk);
+	} else {
+		pclk = clk_get(&dev->dev, "pclk");
+		if (IS_ERR(pclk)) {
+			dev_info(&dev->dev, "can't get pclk value.\n");
+		} else {
+			udev->pclk_hz = clk_get_rate(pclk);
+			clk_put(pclk);
+		}
+	}
+	if (!udev->pclk_hz)
+		udev->pclk_hz = 250000000;
 
-	udev->poll_task =
-		kthread_create(macb_uio_poll, info, "poll_macb_uio%d", info->uio_dev->minor);
-	kthread_bind(udev->poll_task, 0);
-	wake_up_process(udev->poll_task);
+	str = "Unknown";
+	if (dev->dev.of_node)
+		device_property_read_string(&dev->dev, "compatible", &str);
+	else if (has_acpi_companion(&dev->dev))
+		str = acpi_device_hid(ACPI_COMPANION(&dev->dev));
+	strscpy(udev->dev_type, str, sizeof(udev->dev_type));
 
-	return 0;
+	str = "Unknown";
+	device_property_read_string(&dev->dev, "phy-mode", &str);
+	strscpy(udev->phy_mode, str, sizeof(udev->phy_mode));
+
+	for (i = 0; i < MAX_UIO_MAPS; i++) {
+		res = platform_get_resource(dev, IORESOURCE_MEM, i);
+		if (res) {
+			udev->physical_addr = res->start;
+			break;
+		}
+	}
 }
 
-static int macb_uio_release(struct uio_info *info, struct inode *inode)
+/* Snapshot what MACB_UIO_IOC_GET_DESC returns once probe is complete */
+static void macb_uio_setup_desc(struct rte_uio_platform_dev *udev)
 {
-	struct rte_uio_platform_dev *udev = info->priv;
-
-	if (atomic_dec_and_test(&udev->refcnt))
-		kthread_stop(udev->poll_task);
+	struct macb_uio_desc *desc = &udev->desc;
+	struct macb_uio_queue *queue;
+	struct uio_mem *mem;
+	unsigned int i;
+
+	desc->version = MACB_UIO_DESC_VERSION;
+	desc->size = sizeof(*desc);
+	if (udev->caps.is_gem)
+		desc->flags |= MACB_UIO_DESC_GEM;
+	if (udev->fixed_link) {
+		desc->flags |= MACB_UIO_DESC_FIXED_LINK;
+		desc->fixed_speed = udev->fixed_status.speed;
+		desc->fixed_duplex = udev->fixed_status.duplex == DUPLEX_FULL;
+	}
+	if (udev->phydev)
+		desc->flags |= MACB_UIO_DESC_PHY_MANAGED;
+	desc->uio_minor = udev->info.uio_dev->minor;
+	desc->pclk_hz = udev->pclk_hz;
+	desc->physical_addr = udev->physical_addr;
+	desc->dma_mask_bits = udev->dma_mask_bits;
+	desc->queue_mask = udev->caps.queue_mask;
+	desc->ring_addr = udev->rings.dma_addr;
+	desc->ring_size = udev->ring_size;
+	desc->pool_addr = udev->pool.dma_addr;
+	desc->pool_size = udev->pool.size;
+	desc->ptp_index = udev->ptp ? ptp_clock_index(udev->ptp) : -1;
+	if (udev->dma_coherent)
+		desc->flags |= MACB_UIO_DESC_DMA_COHERENT;
+	desc->cache_line_size = udev->cache_line_size;
+	desc->desc_align = udev->desc_align;
+
+	for (i = 0; i < MACB_UIO_MAX_QUEUES; i++)
+		desc->queue_uio_minor[i] = -1;
+	for (i = 0; i < udev->nr_irqs; i++) {
+		queue = &udev->queues[i];
+		if (queue->has_uio)
+			desc->queue_uio_minor[queue->index] = queue->info.uio_dev->minor;
+	}
 
-	return 0;
+	strscpy(desc->dev_type, udev->dev_type, sizeof(desc->dev_type));
+	strscpy(desc->phy_mode, udev->phy_mode, sizeof(desc->phy_mode));
+
+	desc->nr_maps = min_t(unsigned int, udev->nr_maps, MACB_UIO_DESC_MAPS);
+	for (i = 0; i < desc->nr_maps; i++) {
+		mem = &udev->info.mem[i];
+		strscpy(desc->maps[i].name, mem->name, sizeof(desc->maps[i].name));
+		desc->maps[i].addr = mem->memtype == UIO_MEM_PHYS ? mem->addr : 0;
+		desc->maps[i].size = mem->size;
+		desc->maps[i].offs = mem->offs;
+		desc->maps[i].prot = udev->maps[i].prot;
+	}
 }
 
 /* Unmap previously ioremap'd resources */
@@ -228,30 +3394,106 @@ static void macb_uio_release_iomem(struct uio_info *info)
 	}
 }
 
-/* Remap platform device's resources */
+/*
+ * Export a register block as the next map. addr stays page aligned as
+ * uio wants it, offs (maps/mapN/offset) locates the block in the page.
+ */
+static int macb_uio_add_iomem(struct rte_uio_platform_dev *udev, const char *name,
+							  const struct resource *res)
+{
+	struct uio_mem *mem;
+	int mi = udev->nr_maps;
+
+	if (mi >= MAX_UIO_MAPS)
+		return -ENOSPC;
+
+	mem = &udev->info.mem[mi];
+	mem->memtype = UIO_MEM_PHYS;
+	mem->addr = res->start & PAGE_MASK;
+	mem->offs = res->start & ~PAGE_MASK;
+	mem->size = PAGE_ALIGN(mem->offs + resource_size(res));
+	mem->name = name;
+	udev->maps[mi].type = MACB_UIO_MAP_REGS;
+	udev->maps[mi].prot = udev->regs_prot;
+
+	return udev->nr_maps++;
+}
+
+/*
+ * Remap platform device's resources. The maps take their names from
+ * reg-names, except the first one which stays "macb_regs" for the PMDs
+ * that look it up by that name. Without reg-names (always on ACPI) the
+ * other blocks are "regsN", N being their map index.
+ */
 static int macb_uio_setup_iomem(struct platform_device *dev,
-								struct uio_info *info)
+								struct rte_uio_platform_dev *udev)
 {
+	struct uio_info *info = &udev->info;
+	const char *name;
 	int i, iom = 0;
 	struct resource *res;
 
+	/* Strict, as uio maps physical memory, unless posted writes are asked for */
+	i = sysfs_match_string(macb_uio_prot_names, regs_mapping);
+	if (i == MACB_UIO_PROT_DEVICE || i == MACB_UIO_PROT_STRICT) {
+		udev->regs_prot = i;
+	} else {
+		dev_warn(&dev->dev, "Unsupported regs_mapping \"%s\", using strict.\n",
+				 regs_mapping);
+		udev->regs_prot = MACB_UIO_PROT_STRICT;
+	}
+
 	for (i = 0; i < MAX_UIO_MAPS; i++) {
 		res = platform_get_resource(dev, IORESOURCE_MEM, i);
 		if (!res)
 			continue;
 
-		info->mem[iom].memtype = UIO_MEM_PHYS;
-		info->mem[iom].addr = res->start & PAGE_MASK;
-		info->mem[iom].size = PAGE_ALIGN(resource_size(res));
-		info->mem[iom].name = "macb_regs";
+		name = MACB_UIO_MAP_GEM;
+		if (iom && (!dev->dev.of_node ||
+			    of_property_read_string_index(dev->dev.of_node, "reg-names", i, &name))) {
+			snprintf(udev->regs_names[iom], sizeof(udev->regs_names[iom]), "regs%d", iom);
+			name = udev->regs_names[iom];
+		}
+
+		iom = macb_uio_add_iomem(udev, name, res);
 		info->mem[iom].internal_addr =
 			ioremap(info->mem[iom].addr, info->mem[iom].size);
+		if (iom == 0 && info->mem[iom].internal_addr)
+			udev->regs = info->mem[iom].internal_addr + info->mem[iom].offs;
 		iom++;
 	}
 
 	return (iom != 0) ? 0 : -ENOENT;
 }
 
+/*
+ * Export the register block of the SerDes referenced by the DT phys
+ * property as "serdes", so the PMD can switch speeds itself. It comes
+ * after every other map so their indexes do not depend on it.
+ */
+static void macb_uio_setup_aux_iomem(struct rte_uio_platform_dev *udev)
+{
+	struct device_node *np = udev->pdev->dev.of_node;
+	struct device_node *phy_np;
+	struct resource res;
+	int err;
+
+	if (!np)
+		return;
+
+	phy_np = of_parse_phandle(np, "phys", 0);
+	if (!phy_np)
+		return;
+
+	err = of_address_to_resource(phy_np, 0, &res);
+	of_node_put(phy_np);
+	if (err)
+		return;
+
+	if (macb_uio_add_iomem(udev, MACB_UIO_MAP_SERDES, &res) < 0)
+		dev_warn(&udev->pdev->dev, "No uio map left for the SerDes registers.\n");
+}
+
 /*
  * macb_uio_probe() - platform uio driver probe routine
  * - register uio devices filled with memory maps retrieved from device tree
@@ -268,7 +3510,7 @@ static int macb_uio_probe(struct platform_device *dev)
 		return -ENOMEM;
 
 	/* remap IO memory */
-	err = macb_uio_setup_iomem(dev, &udev->info);
+	err = macb_uio_setup_iomem(dev, udev);
 	if (err) {
 		dev_err(&dev->dev, "There is no resource for register uio device.\n");
 		goto fail_release_iomem;
@@ -279,15 +3521,54 @@ static int macb_uio_probe(struct platform_device *dev)
 	udev->info.version = DRIVER_VERSION;
 	udev->info.open = macb_uio_open;
 	udev->info.release = macb_uio_release;
+	udev->info.irqcontrol = macb_uio_irqcontrol;
+	udev->info.mmap = macb_uio_mmap;
 	udev->info.irq = UIO_IRQ_CUSTOM;
 	udev->info.priv = udev;
 	udev->pdev = dev;
 	atomic_set(&udev->refcnt, 0);
+	spin_lock_init(&udev->irq_lock);
+	INIT_LIST_HEAD(&udev->poll_node);
+	INIT_LIST_HEAD(&udev->subscribers);
+	spin_lock_init(&udev->status_lock);
+	udev->fixed_link = !macb_uio_get_fixed_link(&dev->dev, &udev->fixed_status);
+	macb_uio_read_props(dev, udev);
+	macb_uio_read_caps(udev);
+	macb_uio_set_dma_mask(udev);
+	macb_uio_read_dma_attrs(udev);
+	platform_set_drvdata(dev, udev);
 
-	err = sysfs_create_group(&dev->dev.kobj, &dev_attr_grp);
-	if (err != 0)
+	err = macb_uio_setup_hk_mask(udev);
+	if (err)
+		goto fail_release_iomem;
+
+	err = macb_uio_setup_phy(udev);
+	if (err)
 		goto fail_release_iomem;
 
+	err = macb_uio_setup_status(udev);
+	if (err)
+		goto fail_release_phy;
+
+	err = macb_uio_setup_events(udev);
+	if (err)
+		goto fail_release_status;
+
+	if (ring_size) {
+		err = macb_uio_setup_rings(udev);
+		if (err)
+			goto fail_release_events;
+	}
+
+	if (pool_size)
+		macb_uio_setup_pool(udev);
+
+	macb_uio_setup_aux_iomem(udev);
+
+	err = sysfs_create_groups(&dev->dev.kobj, dev_attr_grps);
+	if (err != 0)
+		goto fail_release_rings;
+
 	/* register uio driver */
 	err = uio_register_device(&dev->dev, &udev->info);
 	if (err) {
@@ -295,13 +3576,35 @@ static int macb_uio_probe(struct platform_device *dev)
 		goto fail_remove_group;
 	}
 
-	platform_set_drvdata(dev, udev);
+	err = macb_uio_register_ctl(udev);
+	if (err) {
+		dev_err(&dev->dev, "Failed to register control device.\n");
+		goto fail_unregister;
+	}
+
+	err = macb_uio_setup_irqs(dev, udev);
+	if (err)
+		goto fail_deregister_ctl;
+
+	macb_uio_setup_ptp(udev);
+	macb_uio_setup_desc(udev);
+	macb_uio_setup_debugfs(udev);
+
+	/* Bring the link up now so it is ready when the PMD starts */
+	if (phy_early_start)
+		macb_uio_phy_start(udev);
 
 	/*
 	 * Doing a harmless dma mapping for attaching the device to
 	 * the iommu identity mapping if kernel boots with iommu=pt.
-	 * Note this is not a problem if no IOMMU at all.
+	 * Note this is not a problem if no IOMMU at all. The descriptor
+	 * ring region already did that when it is enabled. With the IOMMU
+	 * in translated mode, userspace maps its memory through
+	 * MACB_UIO_IOC_DMA_MAP on /dev/macb_uioN instead.
 	 */
+	if (udev->rings.cpu_addr)
+		return 0;
+
 	map_addr = dma_alloc_coherent(&dev->dev, 1024, &map_dma_addr, GFP_KERNEL);
 	if (map_addr)
 		memset(map_addr, 0, 1024);
@@ -319,11 +3622,27 @@ static int macb_uio_probe(struct platform_device *dev)
 
 	return 0;
 
+fail_deregister_ctl:
+	misc_deregister(&udev->ctl);
+	macb_uio_detach_subscribers(udev);
+fail_unregister:
+	uio_unregister_device(&udev->info);
 fail_remove_group:
-	sysfs_remove_group(&dev->dev.kobj, &dev_attr_grp);
+	sysfs_remove_groups(&dev->dev.kobj, dev_attr_grps);
+fail_release_rings:
+	macb_uio_free_dma(udev, &udev->pool);
+	macb_uio_free_dma(udev, &udev->rings);
+fail_release_events:
+	macb_uio_release_events(udev);
+fail_release_status:
+	macb_uio_release_status(udev);
+fail_release_phy:
+	macb_uio_release_phy(udev);
 fail_release_iomem:
 	macb_uio_release_iomem(&udev->info);
 
+	platform_set_drvdata(dev, NULL);
+	free_cpumask_var(udev->hk_mask);
 	kfree(udev);
 
 	return err;
@@ -336,29 +3655,234 @@ static int macb_uio_remove(struct platform_device *dev)
 	if (!udev)
 		return -EINVAL;
 
+	debugfs_remove_recursive(udev->dbg.dir);
 	macb_uio_release(&udev->info, NULL);
-
-	sysfs_remove_group(&dev->dev.kobj, &dev_attr_grp);
+	/* Also with persist, the rings and pool are freed below */
+	macb_uio_stop_dma(udev);
+	if (!list_empty(&udev->poll_node))
+		macb_uio_poll_del(udev);
+
+	macb_uio_release_ptp(udev);
+	macb_uio_free_irqs(udev);
+	misc_deregister(&udev->ctl);
+	sysfs_remove_groups(&dev->dev.kobj, dev_attr_grps);
+	/* The PHY state machine raises events on the uio device */
+	macb_uio_release_phy(udev);
 	uio_unregister_device(&udev->info);
+	macb_uio_free_dma(udev, &udev->pool);
+	macb_uio_free_dma(udev, &udev->rings);
+	macb_uio_detach_subscribers(udev);
+	macb_uio_release_events(udev);
+	macb_uio_release_status(udev);
 	macb_uio_release_iomem(&udev->info);
 	platform_set_drvdata(dev, NULL);
+	free_cpumask_var(udev->hk_mask);
 	kfree(udev);
 
 	return 0;
 }
 
+/*
+ * Built with MODULE_CFLAGS=-DMACB_UIO_MATCH_TABLE, macb_uio matches the
+ * Phytium GEMs itself, and is autoloaded for them, like the macb driver
+ * would be. Without it, only driver_override binds devices.
+ */
+#ifdef MACB_UIO_MATCH_TABLE
+static const struct of_device_id macb_uio_of_match[] = {
+	{ .compatible = "cdns,phytium-gem-1.0" },
+	{ .compatible = "cdns,phytium-gem-2.0" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, macb_uio_of_match);
+#define MACB_UIO_OF_MATCH	macb_uio_of_match
+#else
+#define MACB_UIO_OF_MATCH	NULL
+#endif
+
 static struct platform_driver macb_uio_driver = {
 	.driver = {
 			.owner = THIS_MODULE,
 			.name = DRIVER_NAME,
-			.of_match_table = NULL,
+			.of_match_table = MACB_UIO_OF_MATCH,
 			.acpi_match_table = NULL,
 		},
 	.probe = macb_uio_probe,
 	.remove = macb_uio_remove,
 };
 
-module_platform_driver(macb_uio_driver);
+static bool macb_uio_claim_match(struct device *dev, const char *id)
+{
+	if (!strcmp(dev_name(dev), id))
+		return true;
+	if (dev->of_node && of_device_is_compatible(dev->of_node, id))
+		return true;
+#ifdef CONFIG_ACPI
+	if (has_acpi_companion(dev) && !strcmp(acpi_device_hid(ACPI_COMPANION(dev)), id))
+		return true;
+#endif
+
+	return false;
+}
+
+/* Whether one of the comma separated claim entries names the device */
+static bool macb_uio_claimed(struct device *dev)
+{
+	const char *p = claim;
+	char id[64];
+	size_t len;
+
+	while (p && *p) {
+		len = strcspn(p, ",");
+		if (len && len < sizeof(id)) {
+			memcpy(id, p, len);
+			id[len] = '\0';
+			if (macb_uio_claim_match(dev, strim(id)))
+				return true;
+		}
+		p += len;
+		if (*p)
+			p++;
+	}
+
+	return false;
+}
+
+/* Set driver_override to macb_uio, or clear it when name is NULL */
+static int macb_uio_set_override(struct platform_device *pdev, const char *name)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+	/* A lone newline is how driver_set_override() clears */
+	if (!name)
+		return driver_set_override(&pdev->dev, &pdev->driver_override, "\n", 1);
+
+	return driver_set_override(&pdev->dev, &pdev->driver_override,
+							   name, strlen(name));
+#else
+	char *old;
+
+	if (name) {
+		name = kstrdup(name, GFP_KERNEL);
+		if (!name)
+			return -ENOMEM;
+	}
+
+	device_lock(&pdev->dev);
+	old = pdev->driver_override;
+	pdev->driver_override = (char *)name;
+	device_unlock(&pdev->dev);
+	kfree(old);
+
+	return 0;
+#endif
+}
+
+/*
+ * Point a claimed device at macb_uio and take it from its current
+ * driver, the driver core probes it against macb_uio once registered.
+ */
+static int macb_uio_claim_one(struct device *dev, void *data)
+{
+	if (!macb_uio_claimed(dev))
+		return 0;
+
+	if (macb_uio_set_override(to_platform_device(dev), DRIVER_NAME)) {
+		dev_warn(dev, "Failed to claim for %s.\n", DRIVER_NAME);
+		return 0;
+	}
+
+	if (dev->driver && strcmp(dev->driver->name, DRIVER_NAME)) {
+		dev_info(dev, "Unbinding from %s for %s.\n", dev->driver->name, DRIVER_NAME);
+		device_release_driver(dev);
+	}
+
+	return 0;
+}
+
+/*
+ * Undo a claim on unload: drop the override unless someone changed it
+ * since, and let the driver core hand the port back to macb.
+ */
+static int macb_uio_unclaim_one(struct device *dev, void *data)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	bool ours;
+
+	if (!macb_uio_claimed(dev))
+		return 0;
+
+	device_lock(dev);
+	ours = pdev->driver_override && !strcmp(pdev->driver_override, DRIVER_NAME);
+	device_unlock(dev);
+	if (!ours || macb_uio_set_override(pdev, NULL))
+		return 0;
+
+	if (!dev->driver && device_attach(dev) < 0)
+		dev_warn(dev, "Failed to rebind after %s unload.\n", DRIVER_NAME);
+
+	return 0;
+}
+
+/* Devices registered after load are claimed before any driver sees them */
+static int macb_uio_claim_notify(struct notifier_block *nb,
+								 unsigned long action, void *data)
+{
+	struct device *dev = data;
+
+	if (action == BUS_NOTIFY_ADD_DEVICE && macb_uio_claimed(dev))
+		macb_uio_claim_one(dev, NULL);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block macb_uio_claim_nb = {
+	.notifier_call = macb_uio_claim_notify,
+};
+
+static enum cpuhp_state macb_uio_cpuhp_state;
+
+static int __init macb_uio_init(void)
+{
+	int err;
+
+	err = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN, "net/macb_uio:online",
+									NULL, macb_uio_cpu_offline);
+	if (err < 0)
+		return err;
+	macb_uio_cpuhp_state = err;
+
+	macb_uio_debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+
+	if (claim) {
+		bus_register_notifier(&platform_bus_type, &macb_uio_claim_nb);
+		bus_for_each_dev(&platform_bus_type, NULL, NULL, macb_uio_claim_one);
+	}
+
+	err = platform_driver_register(&macb_uio_driver);
+	if (err) {
+		if (claim) {
+			bus_unregister_notifier(&platform_bus_type, &macb_uio_claim_nb);
+			bus_for_each_dev(&platform_bus_type, NULL, NULL, macb_uio_unclaim_one);
+		}
+		debugfs_remove_recursive(macb_uio_debugfs);
+		cpuhp_remove_state_nocalls(macb_uio_cpuhp_state);
+	}
+
+	return err;
+}
+
+static void __exit macb_uio_exit(void)
+{
+	if (claim)
+		bus_unregister_notifier(&platform_bus_type, &macb_uio_claim_nb);
+	platform_driver_unregister(&macb_uio_driver);
+	if (claim)
+		bus_for_each_dev(&platform_bus_type, NULL, NULL, macb_uio_unclaim_one);
+	debugfs_remove_recursive(macb_uio_debugfs);
+	cpuhp_remove_state_nocalls(macb_uio_cpuhp_state);
+}
+
+module_init(macb_uio_init);
+module_exit(macb_uio_exit);
 
 MODULE_VERSION(DRIVER_VERSION);
 MODULE_LICENSE("GPL");
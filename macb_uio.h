@@ -0,0 +1,298 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/* Copyright(c) 2022 - 2025 Phytium Technology Co., Ltd. */
+
+#ifndef _MACB_UIO_H_
+#define _MACB_UIO_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Layout of the memory macb_uio shares with userspace. Every shared
+ * map starts with a version and the size the kernel filled in, so a
+ * PMD built against an older header can still use the fields it knows.
+ */
+
+#define MACB_UIO_STATUS_VERSION	1
+
+/* Name of the read-only uio map holding struct macb_uio_status */
+#define MACB_UIO_MAP_STATUS	"status"
+
+/*
+ * Name of the uio map holding the descriptor rings. For the Nth present
+ * queue, its RX ring starts at 2 * N * ring_size and its TX ring at
+ * (2 * N + 1) * ring_size, ring_size being published in sysfs next to
+ * the bus address of the region (ring_addr).
+ */
+#define MACB_UIO_MAP_RINGS	"rings"
+
+/*
+ * Name of the uio map holding the contiguous packet buffer pool, its
+ * bus address and size are published in sysfs (pool_addr, pool_size).
+ */
+#define MACB_UIO_MAP_POOL	"pool"
+
+/*
+ * Register maps are "macb_regs" for the GEM core, then named after the
+ * DT reg-names of the other blocks, "regsN" (N the map index) when
+ * there are none, as on ACPI. Every register map reports where
+ * the block starts in its first page in maps/mapN/offset, "serdes" is
+ * the block of the SerDes the DT phys property points at.
+ */
+#define MACB_UIO_MAP_GEM	"macb_regs"
+#define MACB_UIO_MAP_SERDES	"serdes"
+
+/* Name of the read-write uio map holding struct macb_uio_events */
+#define MACB_UIO_MAP_EVENTS	"events"
+
+#define MACB_UIO_EVENTS_VERSION	1
+
+#define MACB_UIO_MAX_QUEUES	8
+
+#define MACB_UIO_PAUSE_RX	(1 << 0)
+#define MACB_UIO_PAUSE_TX	(1 << 1)
+
+/**
+ * Link state as last seen by the kernel.
+ *
+ * The kernel makes seq odd while it updates the other fields and even
+ * again once it is done, readers retry while seq is odd or changed
+ * under them. generation is bumped on every link transition.
+ */
+struct macb_uio_link_status {
+	__u32 seq;
+	__u32 generation;
+	__u32 link_up;
+	__u32 speed;	/* Mb/s */
+	__u32 duplex;	/* 0: half, 1: full */
+	__u32 pause;	/* MACB_UIO_PAUSE_* */
+	__u32 reserved[2];
+};
+
+/* GEM statistics registers, 0x100 to 0x1b0 */
+#define MACB_UIO_NR_STATS	45
+
+/**
+ * GEM statistics, accumulated by the kernel when loaded with
+ * stats_accumulate=1. counter[i] is the sum of every value read from
+ * the clear-on-read register at 0x100 + 4 * i, so the 48-bit octet
+ * counters are counter[0] + (counter[1] << 32) for TX and
+ * counter[26] + (counter[27] << 32) for RX. seq works as in
+ * struct macb_uio_link_status, generation is bumped on every fold.
+ */
+struct macb_uio_stats {
+	__u32 seq;
+	__u32 generation;
+	__u32 reserved[2];
+	__u64 counter[MACB_UIO_NR_STATS];
+};
+
+/*
+ * state_generation changes every time the driver drops the state a
+ * closing PMD left behind (rings, pmd_state of the events page). With
+ * the module loaded with persist=1 it only changes across a reload, so
+ * a restarted PMD that finds the generation it saved can adopt the
+ * running rings instead of resetting the MAC.
+ */
+struct macb_uio_status {
+	__u32 version;
+	__u32 size;
+	__u32 state_generation;
+	__u32 reserved;
+	struct macb_uio_link_status link;
+	struct macb_uio_stats stats;	/* if size covers it */
+};
+
+/* Driver generated causes in macb_uio_events.sw_cause */
+#define MACB_UIO_EV_LINK	(1 << 0)	/* link state changed */
+#define MACB_UIO_EV_TX_HANG	(1 << 1)	/* transmitter stuck, watchdog_ms */
+#define MACB_UIO_EV_RX_OVERRUN	(1 << 2)	/* RSR.OVR seen, watchdog_ms */
+#define MACB_UIO_EV_RX_NOBUF	(1 << 3)	/* RSR.BNA seen, watchdog_ms */
+
+/**
+ * Causes of one hardware queue, on a cache line of its own so lcores
+ * serving different queues do not share it.
+ *
+ * The top half ORs the ISR bits it masked into isr before notifying
+ * userspace, the handler takes them with an atomic exchange against 0
+ * instead of reading ISR over MMIO. events counts the interrupts.
+ */
+struct macb_uio_queue_events {
+	__u32 isr;
+	__u32 events;
+	__u64 notify_ns;	/* CLOCK_MONOTONIC of the last notification */
+	__u32 reserved[12];
+};
+
+/* Words of the events page the driver never interprets */
+#define MACB_UIO_PMD_STATE_WORDS	256
+
+struct macb_uio_events {
+	__u32 version;
+	__u32 size;
+	__u32 event_count;	/* notifications raised on the main device */
+	__u32 sw_cause;		/* MACB_UIO_EV_*, consumed like isr */
+	__u64 sw_notify_ns;	/* CLOCK_MONOTONIC of the last sw_cause raise */
+	__u32 reserved[10];
+	struct macb_uio_queue_events queue[MACB_UIO_MAX_QUEUES];	/* by hw queue */
+	__u32 pmd_state[MACB_UIO_PMD_STATE_WORDS];	/* kept for the next opener */
+};
+
+/* Memory attributes of a map, see the regs_mapping parameter */
+enum macb_uio_prot {
+	MACB_UIO_PROT_DEVICE,	/* Device-nGnRE, as ioremap() */
+	MACB_UIO_PROT_STRICT,	/* Device-nGnRnE, pgprot_noncached() */
+	MACB_UIO_PROT_WC,	/* Normal non-cacheable, never for register maps */
+	MACB_UIO_PROT_CACHED,	/* Normal cacheable, kernel pages */
+	MACB_UIO_PROT_DMA,	/* chosen by the DMA API for the device */
+};
+
+#define MACB_UIO_DESC_VERSION	1
+#define MACB_UIO_DESC_MAPS	8
+
+/* Set in macb_uio_desc.flags */
+#define MACB_UIO_DESC_GEM		(1 << 0)
+#define MACB_UIO_DESC_FIXED_LINK	(1 << 1)	/* fixed_speed/fixed_duplex valid */
+#define MACB_UIO_DESC_PHY_MANAGED	(1 << 2)	/* phy_manage=1, no MDIO from userspace */
+#define MACB_UIO_DESC_DMA_COHERENT	(1 << 3)	/* no cache maintenance needed */
+
+struct macb_uio_desc_map {
+	char name[16];
+	__u64 addr;	/* physical or bus address, 0 for kernel pages */
+	__u64 size;
+	__u32 offs;	/* of the region within the first page */
+	__u32 prot;	/* enum macb_uio_prot */
+};
+
+/**
+ * Everything about a device that does not change after probe, the
+ * sysfs attributes of the same name hold the same values.
+ */
+struct macb_uio_desc {
+	__u32 version;
+	__u32 size;
+	__u32 flags;		/* MACB_UIO_DESC_* */
+	__u32 uio_minor;
+	__u64 pclk_hz;
+	__u64 physical_addr;
+	__u32 dma_mask_bits;
+	__u32 fixed_speed;	/* Mb/s */
+	__u32 fixed_duplex;	/* 0: half, 1: full */
+	__u32 queue_mask;	/* caps/queue_mask */
+	__u64 ring_addr;
+	__u64 ring_size;
+	__u64 pool_addr;
+	__u64 pool_size;
+	__s32 ptp_index;	/* -1 without PTP clock */
+	__u32 nr_maps;
+	__s32 queue_uio_minor[MACB_UIO_MAX_QUEUES];	/* by hw queue, -1 if none */
+	char dev_type[64];
+	char phy_mode[32];
+	struct macb_uio_desc_map maps[MACB_UIO_DESC_MAPS];
+	__u32 cache_line_size;	/* if size covers it */
+	__u32 desc_align;	/* recommended descriptor alignment in bytes */
+};
+
+/**
+ * Copy the descriptor to addr. size is the room there on entry and
+ * the size of the kernel descriptor on return, the kernel copies the
+ * smaller of the two.
+ */
+struct macb_uio_desc_req {
+	__u64 addr;
+	__u32 size;
+	__u32 reserved;
+};
+
+/*
+ * ioctls of the control device /dev/macb_uioN, N being the minor of
+ * the matching /dev/uioN.
+ */
+#define MACB_UIO_IOC_MAGIC	'M'
+
+/**
+ * A user buffer to map for DMA. vaddr and size must be page aligned,
+ * iova returns the address the device has to use. Without an IOMMU the
+ * buffer must be physically contiguous (-EFBIG otherwise) and within
+ * the DMA mask of the device (-ERANGE otherwise), it is never bounced. Mappings are torn
+ * down with MACB_UIO_IOC_DMA_UNMAP (matched on iova) or when the file
+ * descriptor is closed.
+ *
+ * Closing a control file that still holds mappings stops the MAC (NCR
+ * RE and TE cleared) before they are unmapped, also with persist=1.
+ * A PMD that wants the MAC to keep running across a restart has to put
+ * its buffers in the pool map, which lives as long as the driver, and
+ * must not unmap a buffer descriptors still point at.
+ */
+struct macb_uio_dma_map {
+	__u64 vaddr;
+	__u64 size;
+	__u64 iova;
+};
+
+/**
+ * Causes an opener of the control device wants to be woken for:
+ * MACB_UIO_EV_* bits and a mask of hw queues (bit 0 for queue 0).
+ * Queue events are only seen while the primary has them armed. read()
+ * then returns one struct macb_uio_event with the causes accumulated
+ * since the previous read, poll() reports them as readable.
+ */
+struct macb_uio_event_filter {
+	__u32 sw_cause;
+	__u32 queue_mask;
+};
+
+struct macb_uio_event {
+	__u32 count;	/* matching notifications folded in */
+	__u32 sw_cause;
+	__u32 queue_mask;
+	__u32 reserved;
+};
+
+#define MACB_UIO_IOC_DMA_MAP	_IOWR(MACB_UIO_IOC_MAGIC, 1, struct macb_uio_dma_map)
+#define MACB_UIO_IOC_DMA_UNMAP	_IOW(MACB_UIO_IOC_MAGIC, 2, struct macb_uio_dma_map)
+#define MACB_UIO_IOC_SET_FILTER	_IOW(MACB_UIO_IOC_MAGIC, 3, struct macb_uio_event_filter)
+#define MACB_UIO_IOC_GET_DESC	_IOWR(MACB_UIO_IOC_MAGIC, 4, struct macb_uio_desc_req)
+
+#ifndef __KERNEL__
+/* Take a consistent copy of the link state, never blocks the kernel */
+static inline void macb_uio_read_link_status(const struct macb_uio_status *status,
+					     struct macb_uio_link_status *link)
+{
+	const struct macb_uio_link_status *src = &status->link;
+	__u32 seq;
+
+	do {
+		seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+		*link = *src;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&src->seq, __ATOMIC_RELAXED));
+}
+
+/* Take a consistent copy of the accumulated statistics */
+static inline void macb_uio_read_stats(const struct macb_uio_status *status,
+				       struct macb_uio_stats *stats)
+{
+	const struct macb_uio_stats *src = &status->stats;
+	__u32 seq;
+
+	do {
+		seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+		*stats = *src;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&src->seq, __ATOMIC_RELAXED));
+}
+
+/* Take and clear the causes latched for hw queue q */
+static inline __u32 macb_uio_take_isr(struct macb_uio_events *events, unsigned int q)
+{
+	return __atomic_exchange_n(&events->queue[q].isr, 0, __ATOMIC_ACQUIRE);
+}
+
+static inline __u32 macb_uio_take_sw_cause(struct macb_uio_events *events)
+{
+	return __atomic_exchange_n(&events->sw_cause, 0, __ATOMIC_ACQUIRE);
+}
+#endif
+
+#endif /* _MACB_UIO_H_ */
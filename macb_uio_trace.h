@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/* Copyright(c) 2022 - 2025 Phytium Technology Co., Ltd. */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM macb_uio
+
+#if !defined(_MACB_UIO_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _MACB_UIO_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+/* Devices are identified by the minor of their main /dev/uioN */
+
+TRACE_EVENT(macb_uio_irq,
+	TP_PROTO(int minor, unsigned int queue, u32 status),
+	TP_ARGS(minor, queue, status),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(unsigned int, queue)
+		__field(u32, status)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->queue = queue;
+		__entry->status = status;
+	),
+	TP_printk("uio%d queue=%u status=%#x",
+		  __entry->minor, __entry->queue, __entry->status)
+);
+
+TRACE_EVENT(macb_uio_notify,
+	TP_PROTO(int minor, int queue, u32 cause, u64 latency_ns),
+	TP_ARGS(minor, queue, cause, latency_ns),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(int, queue)
+		__field(u32, cause)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->queue = queue;
+		__entry->cause = cause;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("uio%d queue=%d cause=%#x latency=%lluns",
+		  __entry->minor, __entry->queue, __entry->cause,
+		  (unsigned long long)__entry->latency_ns)
+);
+
+TRACE_EVENT(macb_uio_irqcontrol,
+	TP_PROTO(int minor, int queue, s32 irq_on),
+	TP_ARGS(minor, queue, irq_on),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(int, queue)
+		__field(s32, irq_on)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->queue = queue;
+		__entry->irq_on = irq_on;
+	),
+	TP_printk("uio%d queue=%d irq_on=%d",
+		  __entry->minor, __entry->queue, __entry->irq_on)
+);
+
+TRACE_EVENT(macb_uio_link,
+	TP_PROTO(int minor, bool up, int speed, int duplex, unsigned int pause),
+	TP_ARGS(minor, up, speed, duplex, pause),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(bool, up)
+		__field(int, speed)
+		__field(int, duplex)
+		__field(unsigned int, pause)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->up = up;
+		__entry->speed = speed;
+		__entry->duplex = duplex;
+		__entry->pause = pause;
+	),
+	TP_printk("uio%d %s speed=%d duplex=%d pause=%#x",
+		  __entry->minor, __entry->up ? "up" : "down",
+		  __entry->speed, __entry->duplex, __entry->pause)
+);
+
+#endif /* _MACB_UIO_TRACE_H_ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE macb_uio_trace
+#include <trace/define_trace.h>